@@ -0,0 +1,59 @@
+#ifndef BACKGROUNDJOB_H
+#define BACKGROUNDJOB_H
+
+#include <QObject>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QSharedPointer>
+#include <QAtomicInt>
+
+// The one background job RangeHistogram, RangeFilter and RangeCounter each keep: a generation
+// that tells a current result from a stale one, a flag the job polls to stop early, and a watcher
+// whose finished() lands on the owner's thread.
+//
+// The jobs read the caller's data, which is only promised to stay valid until the next setData()
+// or the owner's destruction. So cancel() doesn't just raise the flag, it waits for the job.
+template<typename Result>
+class BackgroundJob
+{
+public:
+    explicit BackgroundJob(QObject* owner) :
+        mGeneration(0),
+        mCancel(new QAtomicInt(0)),
+        mWatcher(new QFutureWatcher<Result>(owner))
+    {
+    }
+
+    // runs before ~QObject() deletes the watcher
+    ~BackgroundJob() { cancel(); }
+
+    template<typename Receiver>
+    void onFinished(Receiver* receiver, void (Receiver::*slot)())
+    {
+        QObject::connect(mWatcher, &QFutureWatcher<Result>::finished, receiver, slot);
+    }
+
+    // Stops the running job, if any, and waits until it returned. Results of earlier jobs are
+    // stale from now on.
+    void cancel()
+    {
+        mCancel->store(1);
+        mWatcher->waitForFinished();
+        mCancel = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+        mGeneration++;
+    }
+
+    // Hand the job generation() and cancelFlag() of the same cancel().
+    void setFuture(const QFuture<Result>& future) { mWatcher->setFuture(future); }
+
+    quint64 generation() const { return mGeneration; }
+    QSharedPointer<QAtomicInt> cancelFlag() const { return mCancel; }
+    Result result() const { return mWatcher->result(); }
+
+private:
+    quint64 mGeneration;
+    QSharedPointer<QAtomicInt> mCancel;
+    QFutureWatcher<Result>* mWatcher;
+};
+
+#endif // BACKGROUNDJOB_H
@@ -0,0 +1,684 @@
+// Headless benchmark for the widgets. Prints one JSON document, to stdout or to the file given as
+// first argument, so results can be compared across releases:
+//
+//   rangesliders-benchmark [output.json]
+//
+// Runs on the offscreen platform unless QT_QPA_PLATFORM is set.
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMouseEvent>
+#include <QSysInfo>
+#include <QTemporaryDir>
+#include <QEventLoop>
+
+#include <stdio.h>
+
+#include "rangeslider.h"
+#include "widgetgradienteditor.h"
+#include "gradientlut.h"
+#include "rangefilter.h"
+#include "imagecolormapper.h"
+#include "gradientrasterizer.h"
+#include "gradientcodec.h"
+#include "gradientlibrary.h"
+#include "widgetstats.h"
+#include "inputreplayer.h"
+#include "gradientimporter.h"
+
+namespace
+{
+    QJsonArray results;
+
+    void report(const QString& name, QJsonObject params, const double value, const QString& unit)
+    {
+        params.insert("name", name);
+        params.insert("value", value);
+        params.insert("unit", unit);
+        results.append(params);
+    }
+
+    // Calls f until at least minMsecs passed, returns nanoseconds per call
+    template<typename F>
+    double measure(F f, const int minMsecs = 200)
+    {
+        f(); // warm up caches, lazily created pixmaps etc.
+
+        QElapsedTimer timer;
+        timer.start();
+        qint64 iterations = 0;
+        do
+        {
+            f();
+            iterations++;
+        } while(timer.elapsed() < minMsecs);
+
+        return (double)timer.nsecsElapsed() / iterations;
+    }
+
+    void sendMouse(QWidget* widget, const QEvent::Type type, const QPoint& pos, const Qt::MouseButton button, const Qt::MouseButtons buttons)
+    {
+        QMouseEvent event(type, pos, button, buttons, Qt::NoModifier);
+        QApplication::sendEvent(widget, &event);
+    }
+
+    QMap<float, QColor> randomGradient(const int stops)
+    {
+        QMap<float, QColor> gradient;
+        for(int i=0;i<stops;i++)
+            gradient.insert((float)i / qMax(1, stops - 1), QColor(qrand() % 256, qrand() % 256, qrand() % 256));
+        return gradient;
+    }
+
+    // Paints the widget into an image of the given size and device pixel ratio. With moving set,
+    // changeState() is called before each frame, so caches have to deal with new values.
+    template<typename F>
+    void benchmarkPaint(const QString& name, QWidget* widget, const QSize& size, const qreal dpr, const bool moving, F changeState)
+    {
+        widget->resize(size);
+        QImage image(size * dpr, QImage::Format_ARGB32_Premultiplied);
+        image.setDevicePixelRatio(dpr);
+
+        int frame = 0;
+        const double ns = measure([&]()
+        {
+            if(moving) changeState(frame++);
+            widget->render(&image);
+        });
+
+        QJsonObject params;
+        params.insert("width", size.width());
+        params.insert("height", size.height());
+        params.insert("dpr", dpr);
+        params.insert("moving", moving);
+        report(name, params, ns / 1000.0, "us/frame");
+    }
+
+    void benchmarkPainting()
+    {
+        QWidget parent;
+        parent.resize(800, 100);
+        parent.setAttribute(Qt::WA_DontShowOnScreen);
+        parent.show();
+
+        RangeSlider rangeSlider(0, 1000, 200, 800);
+        FloatingGradientRangeSlider gradientSlider(0, 1000, 200, 800, 0.1);
+        gradientSlider.slotSetColorMap(WidgetGradientEditor::presetGradient(WidgetGradientEditor::PresetJet));
+        WidgetGradientEditor editor(&parent);
+        editor.slotReset(WidgetGradientEditor::PresetJet);
+
+        QList<QWidget*> widgets;
+        widgets << &rangeSlider << &gradientSlider << &editor;
+        for(int i=0;i<widgets.size();i++)
+        {
+            if(!widgets[i]->parentWidget()) widgets[i]->setAttribute(Qt::WA_DontShowOnScreen);
+            widgets[i]->show();
+        }
+
+        const QList<int> widths = QList<int>() << 150 << 600 << 3000;
+        const QList<qreal> dprs = QList<qreal>() << 1.0 << 2.0;
+
+        for(int w=0;w<widths.size();w++)
+        {
+            for(int d=0;d<dprs.size();d++)
+            {
+                for(int moving=0;moving<2;moving++)
+                {
+                    benchmarkPaint("paint.RangeSlider", &rangeSlider, QSize(widths[w], 20), dprs[d], moving, [&](const int frame)
+                    {
+                        rangeSlider.setValues(200 + frame % 100, 800 - frame % 100);
+                    });
+
+                    benchmarkPaint("paint.FloatingGradientRangeSlider", &gradientSlider, QSize(widths[w], 20), dprs[d], moving, [&](const int frame)
+                    {
+                        gradientSlider.setValues(200 + frame % 100, 800 - frame % 100);
+                    });
+
+                    benchmarkPaint("paint.WidgetGradientEditor", &editor, QSize(widths[w], 40), dprs[d], moving, [&](const int frame)
+                    {
+                        QMap<float, QColor> gradient = WidgetGradientEditor::presetGradient(WidgetGradientEditor::PresetJet);
+                        gradient.insert(0.1f + 0.001f * (frame % 100), Qt::white);
+                        editor.setGradient(gradient);
+                    });
+                }
+            }
+        }
+    }
+
+    // Drags the middle of a slider by one pixel per step and counts what gets emitted
+    void benchmarkRangeSliderSignals()
+    {
+        RangeSlider slider(0, 1000, 400, 600);
+        slider.setAttribute(Qt::WA_DontShowOnScreen);
+        slider.resize(600, 20);
+        slider.show();
+
+        int emittedLo = 0, emittedHi = 0, emittedRange = 0, emittedCommitted = 0;
+        QObject::connect(&slider, &RangeSlider::valueLoChanged, [&]() { emittedLo++; });
+        QObject::connect(&slider, &RangeSlider::valueHiChanged, [&]() { emittedHi++; });
+        QObject::connect(&slider, &RangeSlider::rangeChanged, [&]() { emittedRange++; });
+        QObject::connect(&slider, &RangeSlider::rangeCommitted, [&]() { emittedCommitted++; });
+
+        const int steps = 200;
+        QPoint pos(slider.width() / 2, slider.height() / 2);
+        sendMouse(&slider, QEvent::MouseButtonPress, pos, Qt::LeftButton, Qt::LeftButton);
+        for(int i=0;i<steps;i++)
+        {
+            pos.rx() += (i / 50) % 2 ? -1 : 1;
+            sendMouse(&slider, QEvent::MouseMove, pos, Qt::NoButton, Qt::LeftButton);
+            QApplication::processEvents();
+        }
+        sendMouse(&slider, QEvent::MouseButtonRelease, pos, Qt::LeftButton, Qt::NoButton);
+        QApplication::processEvents();
+
+        QJsonObject params;
+        params.insert("steps", steps);
+        report("signals.RangeSlider.valueLoChanged", params, (double)emittedLo / steps, "emissions/step");
+        report("signals.RangeSlider.valueHiChanged", params, (double)emittedHi / steps, "emissions/step");
+        report("signals.RangeSlider.rangeChanged", params, (double)emittedRange / steps, "emissions/step");
+        report("signals.RangeSlider.rangeCommitted", params, (double)emittedCommitted / steps, "emissions/step");
+    }
+
+    // Rescales many floating sliders at once and counts what listeners get per rescale
+    void benchmarkFloatingRescale()
+    {
+        QWidget parent;
+        parent.setAttribute(Qt::WA_DontShowOnScreen);
+        parent.resize(600, 20);
+        parent.show();
+
+        // both handles are within the padding, so releasing grows the range on both sides
+        const int count = 50;
+        QVector<FloatingRangeSlider*> sliders;
+        int emittedRange = 0, settled = 0;
+        QEventLoop loop;
+        for(int i=0;i<count;i++)
+        {
+            FloatingRangeSlider* slider = new FloatingRangeSlider(0, 1000, 50, 950, 0.1f);
+            slider->setParent(&parent);
+            slider->resize(600, 20);
+            slider->show();
+            QObject::connect(slider, &RangeSlider::rangeChanged, [&]()
+            {
+                emittedRange++;
+                if(++settled == count) loop.quit();
+            });
+            sliders.append(slider);
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        for(int i=0;i<count;i++)
+        {
+            const QPoint pos(sliders[i]->width() / 2, sliders[i]->height() / 2);
+            sendMouse(sliders[i], QEvent::MouseButtonPress, pos, Qt::LeftButton, Qt::LeftButton);
+            sendMouse(sliders[i], QEvent::MouseButtonRelease, pos, Qt::LeftButton, Qt::NoButton);
+        }
+        QTimer::singleShot(2000, &loop, &QEventLoop::quit);
+        if(settled < count) loop.exec();
+
+        QJsonObject params;
+        params.insert("sliders", count);
+        report("signals.FloatingRangeSlider.rangeChanged", params, (double)emittedRange / count, "emissions/rescale");
+        report("animation.FloatingRangeSlider.settle", params, timer.elapsed(), "ms");
+    }
+
+    // A drag like a mouse produces: press at from, one move per interval (8 ms is 125 Hz), release
+    InputRecording dragRecording(const QSize& size, const QPoint& from, const int steps, const qint64 intervalUs = 8000)
+    {
+        InputRecording recording;
+        recording.widgetSize = size;
+
+        InputEvent e;
+        e.type = QEvent::MouseButtonPress;
+        e.pos = from;
+        e.button = Qt::LeftButton;
+        e.buttons = Qt::LeftButton;
+        recording.events.append(e);
+
+        e.type = QEvent::MouseMove;
+        e.button = Qt::NoButton;
+        for(int i=0;i<steps;i++)
+        {
+            e.time += intervalUs;
+            e.pos.rx() += (i / 50) % 2 ? -1 : 1;
+            recording.events.append(e);
+        }
+
+        e.type = QEvent::MouseButtonRelease;
+        e.button = Qt::LeftButton;
+        e.buttons = Qt::NoButton;
+        e.time += intervalUs;
+        recording.events.append(e);
+        return recording;
+    }
+
+    void reportReplay(const QString& name, const InputReplayer::Report& replay, const QByteArray& signal)
+    {
+        const double percentiles[] = { 50, 95, 99 };
+        for(int i=0;i<3;i++)
+        {
+            QJsonObject params;
+            params.insert("percentile", percentiles[i]);
+            params.insert("events", replay.events);
+            params.insert("unpaintedEvents", replay.unpaintedEvents);
+            report(name + "." + signal, params, replay.signalPercentile(signal, percentiles[i]), "us");
+            report(name + ".paint", params, replay.paintPercentile(percentiles[i]), "us");
+        }
+    }
+
+    // Replays recorded drags as fast as the widgets take them, through a file like a real recording
+    void benchmarkReplay()
+    {
+        QTemporaryDir dir;
+        InputReplayer replayer;
+
+        {
+            RangeSlider slider(0, 1000, 400, 600);
+            slider.resize(600, 20);
+
+            const QString fileName = dir.path() + "/slider.input";
+            InputRecording recording;
+            dragRecording(slider.size(), QPoint(300, 10), 200).save(fileName);
+            InputRecording::load(fileName, &recording);
+
+            reportReplay("replay.RangeSlider", replayer.replay(recording, &slider, InputReplayer::MaximumSpeed), "valueLoChanged");
+        }
+
+        // a 1000 Hz mouse in real time, per drag mode
+        const char* modes[] = { "immediate", "compressed", "predicted" };
+        for(int mode=0;mode<3;mode++)
+        {
+            RangeSlider slider(0, 1000, 400, 600);
+            slider.resize(600, 20);
+            slider.setDragMode((RangeSlider::DragMode)mode);
+
+            const InputRecording recording = dragRecording(slider.size(), QPoint(300, 10), 500, 1000);
+            const InputReplayer::Report replay = replayer.replay(recording, &slider, InputReplayer::OriginalSpeed);
+
+            QJsonObject params;
+            params.insert("mode", modes[mode]);
+            params.insert("events", replay.events);
+            report("drag.RangeSlider.valueLoChanged", params, (double)replay.signalLatencies.value("valueLoChanged").size() / replay.events, "emissions/event");
+            report("drag.RangeSlider.paint.p95", params, replay.paintPercentile(95), "us");
+        }
+
+        {
+            QWidget parent;
+            parent.resize(600, 100);
+            parent.setAttribute(Qt::WA_DontShowOnScreen);
+            parent.show();
+            WidgetGradientEditor editor(&parent);
+            editor.slotReset(WidgetGradientEditor::PresetJet);
+            editor.resize(600, 40);
+            editor.show();
+
+            // see benchmarkGradientEditorSignals()
+            QImage image(editor.size(), QImage::Format_ARGB32_Premultiplied);
+            editor.render(&image);
+
+            const InputRecording recording = dragRecording(editor.size(), QPoint(300, 35), 200);
+            reportReplay("replay.WidgetGradientEditor", replayer.replay(recording, &editor, InputReplayer::MaximumSpeed), "gradientChanged");
+        }
+    }
+
+    // Drags the middle marker of the jet preset by one pixel per step
+    void benchmarkGradientEditorSignals()
+    {
+        QWidget parent;
+        parent.resize(600, 100);
+        parent.setAttribute(Qt::WA_DontShowOnScreen);
+        parent.show();
+        WidgetGradientEditor editor(&parent);
+        editor.slotReset(WidgetGradientEditor::PresetJet);
+        editor.resize(600, 40);
+        editor.show();
+
+        // the editor lays out its markers when painting, and a click that misses all markers
+        // would open a color dialog
+        QImage image(editor.size(), QImage::Format_ARGB32_Premultiplied);
+        editor.render(&image);
+
+        int emittedChanged = 0;
+        QObject::connect(&editor, &WidgetGradientEditor::gradientChanged, [&]() { emittedChanged++; });
+
+        // markers live in the middle 80% of the widget, the jet preset has one at 0.5
+        const int steps = 200;
+        QPoint pos(editor.width() / 2, editor.height() - 5);
+        sendMouse(&editor, QEvent::MouseButtonPress, pos, Qt::LeftButton, Qt::LeftButton);
+        for(int i=0;i<steps;i++)
+        {
+            pos.rx() += (i / 50) % 2 ? -1 : 1;
+            sendMouse(&editor, QEvent::MouseMove, pos, Qt::NoButton, Qt::LeftButton);
+            QApplication::processEvents();
+        }
+        sendMouse(&editor, QEvent::MouseButtonRelease, pos, Qt::LeftButton, Qt::NoButton);
+        QApplication::processEvents();
+
+        QJsonObject params;
+        params.insert("steps", steps);
+        report("signals.WidgetGradientEditor.gradientChanged", params, (double)emittedChanged / steps, "emissions/step");
+    }
+
+    // Imported palettes have thousands of stops: painting, hit testing and adding a marker
+    void benchmarkGradientEditorScaling()
+    {
+        QWidget parent;
+        parent.resize(1000, 100);
+        parent.setAttribute(Qt::WA_DontShowOnScreen);
+        parent.show();
+
+        const QList<int> stopCounts = QList<int>() << 16 << 256 << 4096;
+        for(int c=0;c<stopCounts.size();c++)
+        {
+            WidgetGradientEditor editor(&parent);
+            editor.resize(1000, 40);
+            editor.setGradient(randomGradient(stopCounts[c]));
+
+            QImage image(editor.size(), QImage::Format_ARGB32_Premultiplied);
+            QJsonObject params;
+            params.insert("stops", stopCounts[c]);
+            report("editor.paint", params, measure([&]() { editor.render(&image); }) / 1000.0, "us/frame");
+
+            // a right click on empty space does nothing, so this is a pure hit test
+            int i = 0;
+            report("editor.hitTest", params, measure([&]()
+            {
+                sendMouse(&editor, QEvent::MouseButtonPress, QPoint(5 + (i++ % 50), 20), Qt::RightButton, Qt::RightButton);
+                sendMouse(&editor, QEvent::MouseButtonRelease, QPoint(5 + (i % 50), 20), Qt::RightButton, Qt::NoButton);
+            }), "ns/click");
+
+            report("editor.addMarker", params, measure([&]() { editor.slotAddMarker(Qt::red, (i++ % 1000) / 1000.0f); editor.getGradient(); }, 50), "ns/call");
+        }
+    }
+
+    void benchmarkSetters()
+    {
+        for(int connected=0;connected<2;connected++)
+        {
+            RangeSlider slider(0, 1000, 200, 800);
+            int sink = 0;
+            if(connected)
+            {
+                QObject::connect(&slider, &RangeSlider::valueLoChanged, [&](int v) { sink += v; });
+                QObject::connect(&slider, &RangeSlider::valueHiChanged, [&](int v) { sink += v; });
+            }
+
+            int i = 0;
+            QJsonObject params;
+            params.insert("connected", (bool)connected);
+            report("setter.setValueLo", params, measure([&]() { slider.setValueLo(100 + (i++ % 100)); }), "ns/call");
+            report("setter.setValueHi", params, measure([&]() { slider.setValueHi(900 - (i++ % 100)); }), "ns/call");
+            report("setter.setValues", params, measure([&]() { const int step = i++ % 100; slider.setValues(100 + step, 900 - step); }), "ns/call");
+        }
+
+        RangeSlider slider(0, 1000, 200, 800);
+        const QSharedPointer<const RangeModel> model = slider.model();
+        quint64 sink = 0;
+        report("model.snapshot", QJsonObject(), measure([&]() { sink += model->snapshot().valueLo; }), "ns/call");
+        report("model.generation", QJsonObject(), measure([&]() { sink += model->generation(); }), "ns/call");
+
+        // what the instrumentation costs when it's off (the default), counting and tracing
+        for(int mode=0;mode<3;mode++)
+        {
+            WidgetStats::setEnabled(mode > 0);
+            WidgetStats::setTracing(mode > 1);
+
+            RangeSlider slider(0, 1000, 200, 800);
+            int i = 0;
+            QJsonObject params;
+            params.insert("stats", mode == 0 ? "off" : mode == 1 ? "counting" : "tracing");
+            report("stats.setValues", params, measure([&]() { const int step = i++ % 100; slider.setValues(100 + step, 900 - step); }), "ns/call");
+        }
+        WidgetStats::setEnabled(false);
+        WidgetStats::reset();
+    }
+
+    void benchmarkGradientStrings()
+    {
+        const QList<int> stopCounts = QList<int>() << 5 << 64 << 256;
+        for(int s=0;s<stopCounts.size();s++)
+        {
+            const QMap<float, QColor> gradient = randomGradient(stopCounts[s]);
+            const QString config = WidgetGradientEditor::gradientToString(gradient);
+
+            int sink = 0;
+            QJsonObject params;
+            params.insert("stops", stopCounts[s]);
+            report("string.gradientToString", params, measure([&]() { sink += WidgetGradientEditor::gradientToString(gradient).size(); }) / 1000.0, "us/call");
+            report("string.stringToGradient", params, measure([&]() { sink += WidgetGradientEditor::stringToGradient(config).size(); }) / 1000.0, "us/call");
+        }
+
+        // a project file's worth of per-layer gradients
+        QVector<QMap<float, QColor> > gradients;
+        for(int g=0;g<10000;g++)
+            gradients.append(randomGradient(8));
+        const QByteArray binary = GradientCodec::encodeList(gradients);
+
+        QJsonObject params;
+        params.insert("gradients", gradients.size());
+        params.insert("stops", 8);
+        int sink = 0;
+        QVector<QMap<float, QColor> > decoded;
+        report("binary.encodeList", params, measure([&]() { sink += GradientCodec::encodeList(gradients).size(); }) / 1e6, "ms/call");
+        report("binary.decodeList", params, measure([&]() { GradientCodec::decodeList(binary, decoded); sink += decoded.size(); }) / 1e6, "ms/call");
+    }
+
+    void benchmarkLut()
+    {
+        const int n = 1 << 20;
+        QVector<float> in(n);
+        QVector<uint32_t> out(n);
+        for(int i=0;i<n;i++) in[i] = (float)qrand() / RAND_MAX;
+
+        const QList<int> resolutions = QList<int>() << GradientLut::Resolution256 << GradientLut::Resolution1024 << GradientLut::Resolution4096;
+        for(int r=0;r<resolutions.size();r++)
+        {
+            const GradientLut lut = GradientLut::fromPreset(WidgetGradientEditor::PresetJet, (GradientLut::Resolution)resolutions[r]);
+
+            QJsonObject params;
+            params.insert("resolution", resolutions[r]);
+            params.insert("samples", n);
+            report("lut.sample", params, measure([&]() { lut.sample(in.constData(), out.data(), n, 0.0f, 1.0f); }) / n, "ns/sample");
+        }
+    }
+
+    void benchmarkFilter()
+    {
+        const int n = 1 << 24;
+        QVector<float> column(n);
+        for(int i=0;i<n;i++) column[i] = (float)qrand() / RAND_MAX * 1000.0f;
+
+        QJsonObject params;
+        params.insert("rows", n);
+
+        RangeFilter filter;
+        filter.setColumn(column.constData(), n);
+        int i = 0;
+        report("filter.fullScan", params, measure([&]() { filter.setBounds(200 + (i++ % 2), 800); }) / 1000.0, "us/call");
+
+        QEventLoop loop;
+        QObject::connect(&filter, &RangeFilter::indexReady, &loop, &QEventLoop::quit);
+        if(!filter.hasIndex()) loop.exec();
+
+        // one handle moving by a value step, like MoveLo
+        report("filter.incremental", params, measure([&]() { filter.setBounds(200 + (i++ % 2), 800); }) / 1000.0, "us/call");
+    }
+
+    void benchmarkColorMapper()
+    {
+        const int size = 4096;
+        QVector<quint16> pixels(size * size);
+        for(int i=0;i<pixels.size();i++) pixels[i] = qrand() & 0xFFFF;
+        QVector<float> pixelsFloat(size * size);
+        for(int i=0;i<pixelsFloat.size();i++) pixelsFloat[i] = pixels[i];
+
+        for(int f=0;f<2;f++)
+        {
+            ImageColorMapper mapper;
+            mapper.setGradient(WidgetGradientEditor::presetGradient(WidgetGradientEditor::PresetJet));
+            if(f == 0) mapper.setSource(pixels.constData(), ImageColorMapper::UInt16, size, size, size * sizeof(quint16));
+            else mapper.setSource(pixelsFloat.constData(), ImageColorMapper::Float32, size, size, size * sizeof(float));
+
+            QJsonObject params;
+            params.insert("format", f == 0 ? "uint16" : "float");
+            params.insert("size", size);
+
+            // a new window each call, so every call renders
+            int i = 0;
+            report("colormap.full", params, measure([&]() { mapper.setWindow(1000 + (i++ % 2), 60000); mapper.render(); }) / 1e6, "ms/call");
+            params.insert("visible", 1024);
+            report("colormap.visible", params, measure([&]() { mapper.setWindow(1000 + (i++ % 2), 60000); mapper.render(QRect(0, 0, 1024, 1024)); }) / 1e6, "ms/call");
+        }
+    }
+
+    void benchmarkRasterizer()
+    {
+        const QMap<float, QColor> gradient = randomGradient(16);
+        const QList<int> widths = QList<int>() << 150 << 600 << 3000;
+        for(int w=0;w<widths.size();w++)
+        {
+            QJsonObject params;
+            params.insert("width", widths[w]);
+            params.insert("stops", 16);
+
+            QImage target(widths[w], 1, QImage::Format_ARGB32_Premultiplied);
+            report("gradient.qlineargradient", params, measure([&]()
+            {
+                QLinearGradient linear(0, 0, widths[w], 0);
+                QMapIterator<float, QColor> i(gradient);
+                while(i.hasNext())
+                {
+                    i.next();
+                    linear.setColorAt(i.key(), i.value());
+                }
+                QPainter p(&target);
+                p.fillRect(target.rect(), QBrush(linear));
+            }) / 1000.0, "us/call");
+
+            int sink = 0;
+            report("gradient.rasterize", params, measure([&]() { sink += GradientRasterizer::rasterize(gradient, QSize(widths[w], 1)).width(); }) / 1000.0, "us/call");
+            report("gradient.rasterizeDithered", params, measure([&]() { sink += GradientRasterizer::rasterize(gradient, QSize(widths[w], 16), true).width(); }) / 1000.0, "us/call");
+            report("gradient.cached", params, measure([&]() { sink += GradientRasterizer::image(gradient, QSize(widths[w], 1)).width(); }) / 1000.0, "us/call");
+        }
+    }
+
+    void benchmarkLibrary()
+    {
+        QTemporaryDir dir;
+        const QString fileName = dir.path() + "/presets.grdb";
+
+        QVector<GradientLibrary::Preset> presets;
+        for(int i=0;i<2000;i++)
+            presets.append(GradientLibrary::Preset(i, QString("colormap %1").arg(i), randomGradient(16)));
+        if(!GradientLibrary::write(fileName, presets)) return;
+
+        QJsonObject params;
+        params.insert("presets", presets.size());
+
+        GradientLibrary library;
+        int sink = 0;
+        report("library.open", params, measure([&]() { sink += library.open(fileName); }) / 1000.0, "us/call");
+
+        int i = 0;
+        const QByteArray name = QByteArray("colormap 1234");
+        report("library.indexOfId", params, measure([&]() { sink += library.indexOfId(i++ % 2000); }), "ns/call");
+        report("library.indexOfName", params, measure([&]() { sink += library.indexOfName(name); }), "ns/call");
+        report("library.stops", params, measure([&]() { sink += library.stops(i++ % 2000).size(); }), "ns/call");
+        report("library.thumbnail", params, measure([&]() { sink += library.thumbnail(i++ % 2000).width(); }), "ns/call");
+    }
+    void benchmarkImporters()
+    {
+        // a ParaView export and a directory of matplotlib style tables, 256 colors each
+        QByteArray json("[");
+        QByteArray table;
+        for(int m=0;m<1000;m++)
+        {
+            if(m > 0) json.append(",");
+            json.append(QString("{\"Name\": \"colormap %1\", \"ColorSpace\": \"RGB\", \"RGBPoints\": [").arg(m).toUtf8());
+            for(int i=0;i<256;i++)
+            {
+                const QByteArray row = QString("%1, %2, %3").arg(i / 255.0).arg((i % 64) / 63.0).arg(1.0 - i / 255.0).toUtf8();
+                if(i > 0) json.append(", ");
+                json.append(QString::number(i / 255.0).toUtf8() + ", " + row);
+                if(m == 0) table.append("[" + row + "],\n");
+            }
+            json.append("]}");
+        }
+        json.append("]");
+
+        QTemporaryDir dir;
+        QStringList fileNames;
+        for(int f=0;f<1000;f++)
+        {
+            QFile file(dir.path() + QString("/map%1.txt").arg(f));
+            if(!file.open(QIODevice::WriteOnly)) return;
+            file.write(table);
+            fileNames.append(file.fileName());
+        }
+
+        int sink = 0;
+        QJsonObject params;
+        params.insert("colormaps", 1000);
+        params.insert("stops", 256);
+        report("import.paraViewJson", params, measure([&]() { sink += GradientImporter::fromData(json, GradientImporter::ParaViewJson).size(); }) / 1e6, "ms/call");
+        report("import.tableFiles", params, measure([&]() { sink += GradientImporter::fromFiles(fileNames).size(); }) / 1e6, "ms/call");
+
+        const QMap<float, QColor> stops = GradientImporter::fromData(table, GradientImporter::Table).value(0).stops;
+        params.insert("colormaps", 1);
+        params.insert("simplifiedStops", GradientImporter::simplify(stops).size());
+        report("import.simplify", params, measure([&]() { sink += GradientImporter::simplify(stops).size(); }) / 1000.0, "us/call");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication app(argc, argv);
+
+    benchmarkPainting();
+    benchmarkRangeSliderSignals();
+    benchmarkGradientEditorSignals();
+    benchmarkFloatingRescale();
+    benchmarkReplay();
+    benchmarkGradientEditorScaling();
+    benchmarkSetters();
+    benchmarkGradientStrings();
+    benchmarkLut();
+    benchmarkFilter();
+    benchmarkColorMapper();
+    benchmarkRasterizer();
+    benchmarkLibrary();
+    benchmarkImporters();
+
+    QJsonObject root;
+    root.insert("qt", QString(qVersion()));
+    root.insert("platform", QGuiApplication::platformName());
+    root.insert("cpu", QSysInfo::currentCpuArchitecture());
+    root.insert("results", results);
+
+    const QByteArray json = QJsonDocument(root).toJson();
+
+    if(argc > 1)
+    {
+        QFile file(argv[1]);
+        if(!file.open(QIODevice::WriteOnly))
+        {
+            qWarning("could not write %s", argv[1]);
+            return 1;
+        }
+        file.write(json);
+    }
+    else
+    {
+        fwrite(json.constData(), 1, json.size(), stdout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,346 @@
+#include "gradientcodec.h"
+
+#include <QtEndian>
+#include <QtNumeric>
+
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+    const char listMagic[4] = {'G', 'R', 'D', 'L'};
+    const int stopBytes = 8;
+
+    // Exact powers of ten, so mantissa * 10^e is correctly rounded for the short numbers
+    // gradientToString() writes.
+    const double powersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    // beyond 255 or below 0 ends up at the bound, NaN at 0, bounded before the cast to int
+    inline int channel(const double value) { return !(value > 0.0) ? 0 : value >= 255.0 ? 255 : (int)value; }
+
+    inline int unit(const char c) { return (uchar)c; }
+    inline int unit(const QChar c) { return c.unicode(); }
+
+    // Reads a decimal number (sign, digits, fraction, exponent) at text[i], advancing i. Returns
+    // false if there are no digits.
+    template<typename Char>
+    bool readNumber(const Char* text, const int length, int& i, double& value)
+    {
+        bool negative = false;
+        if(i < length && (unit(text[i]) == '-' || unit(text[i]) == '+'))
+        {
+            negative = unit(text[i]) == '-';
+            i++;
+        }
+
+        quint64 mantissa = 0;
+        int exponent = 0;
+        int digits = 0;
+        bool fraction = false;
+        for(;i<length;i++)
+        {
+            const int c = unit(text[i]);
+            if(c == '.' && !fraction)
+            {
+                fraction = true;
+                continue;
+            }
+            if(c < '0' || c > '9') break;
+
+            digits++;
+            if(mantissa < Q_UINT64_C(100000000000000000))
+            {
+                mantissa = mantissa * 10 + (c - '0');
+                if(fraction) exponent--;
+            }
+            else if(!fraction)
+            {
+                exponent++; // digits beyond the precision of a double
+            }
+        }
+        if(digits == 0) return false;
+
+        if(i < length && (unit(text[i]) == 'e' || unit(text[i]) == 'E'))
+        {
+            int j = i + 1;
+            bool negativeExponent = false;
+            if(j < length && (unit(text[j]) == '-' || unit(text[j]) == '+'))
+            {
+                negativeExponent = unit(text[j]) == '-';
+                j++;
+            }
+
+            int e = 0;
+            const int first = j;
+            for(;j<length && unit(text[j]) >= '0' && unit(text[j]) <= '9';j++)
+                e = qMin(e * 10 + (unit(text[j]) - '0'), 9999);
+
+            // a lone 'e' isn't part of the number
+            if(j > first)
+            {
+                exponent += negativeExponent ? -e : e;
+                i = j;
+            }
+        }
+
+        // 0e999 is 0, not 0 * infinity
+        if(mantissa == 0) exponent = 0;
+
+        value = (double)mantissa;
+        if(exponent > 0) value *= exponent <= 22 ? powersOfTen[exponent] : pow(10.0, exponent);
+        else if(exponent < 0) value /= -exponent <= 22 ? powersOfTen[-exponent] : pow(10.0, -exponent);
+        if(negative) value = -value;
+        return true;
+    }
+
+    // whether readNumber() turns text into exactly value
+    bool readsBackAs(const QByteArray& text, const float value)
+    {
+        int i = 0;
+        double parsed = 0.0;
+        return readNumber(text.constData(), text.size(), i, parsed) && (float)parsed == value;
+    }
+
+    template<typename Char>
+    bool parse(const Char* text, const int length, QMap<float, QColor>& stops)
+    {
+        stops.clear();
+        bool clean = true;
+
+        int i = 0;
+        while(i < length)
+        {
+            // one stop: up to five numbers separated by ','
+            double fields[5];
+            int count = 0;
+            bool valid = true;
+            while(true)
+            {
+                double value = 0.0;
+                if(count < 5 && readNumber(text, length, i, value)) fields[count++] = value;
+                else valid = false;
+
+                // skip whatever is left of this field
+                while(i < length && unit(text[i]) != ',' && unit(text[i]) != ':')
+                {
+                    valid = false;
+                    i++;
+                }
+
+                if(i < length && unit(text[i]) == ',')
+                {
+                    i++;
+                    continue;
+                }
+                break;
+            }
+
+            // empty stops (as in "a::b" or a trailing ':') are fine, like QString::SkipEmptyParts
+            const bool empty = count == 0 && (i >= length || unit(text[i]) == ':');
+            if(i < length) i++; // ':'
+
+            if(empty) continue;
+            if(!valid || count < 4 || !qIsFinite((float)fields[0]))
+            {
+                clean = false;
+                continue;
+            }
+
+            const int alpha = count == 5 ? channel(fields[4]) : 255;
+            stops.insert((float)fields[0], QColor(channel(fields[1]), channel(fields[2]), channel(fields[3]), alpha));
+        }
+
+        return clean;
+    }
+}
+
+QString GradientCodec::toText(const QMap<float, QColor>& stops)
+{
+    QByteArray text;
+    text.reserve(stops.size() * 24);
+
+    QMapIterator<float, QColor> i(stops);
+    while(i.hasNext())
+    {
+        i.next();
+        const QColor& color = i.value();
+        if(i.hasPrevious()) text.append(':');
+
+        // Same precision QString::arg(double) used, unless that doesn't read back as the same
+        // float, e.g. for stops one float step apart at a hard edge
+        const float key = i.key();
+        QByteArray position = QByteArray::number(key, 'g', 6);
+        for(int precision=9;precision<=17 && !readsBackAs(position, key);precision+=8)
+            position = QByteArray::number(key, 'g', precision);
+        text.append(position);
+        text.append(',');
+        text.append(QByteArray::number(color.red()));
+        text.append(',');
+        text.append(QByteArray::number(color.green()));
+        text.append(',');
+        text.append(QByteArray::number(color.blue()));
+
+        // opaque stops stay readable by older versions
+        if(color.alpha() != 255)
+        {
+            text.append(',');
+            text.append(QByteArray::number(color.alpha()));
+        }
+    }
+
+    return QString::fromLatin1(text);
+}
+
+QMap<float, QColor> GradientCodec::fromText(const QString& text)
+{
+    QMap<float, QColor> stops;
+    parseText(text.constData(), text.size(), stops);
+    return stops;
+}
+
+QMap<float, QColor> GradientCodec::fromText(const QByteArray& text)
+{
+    QMap<float, QColor> stops;
+    parseText(text.constData(), text.size(), stops);
+    return stops;
+}
+
+bool GradientCodec::parseText(const QChar* text, const int length, QMap<float, QColor>& stops)
+{
+    return parse(text, length, stops);
+}
+
+bool GradientCodec::parseText(const char* text, const int length, QMap<float, QColor>& stops)
+{
+    return parse(text, length, stops);
+}
+
+bool GradientCodec::readNumber(const char* text, const int length, int& i, double& value)
+{
+    return ::readNumber(text, length, i, value);
+}
+
+QByteArray GradientCodec::toBinary(const QMap<float, QColor>& stops)
+{
+    QByteArray out;
+    if(!appendBinary(stops, out)) return QByteArray();
+    return out;
+}
+
+bool GradientCodec::appendBinary(const QMap<float, QColor>& stops, QByteArray& out)
+{
+    // the count is 16 bits, writing only some of the stops would look like a valid gradient
+    if(stops.size() > MaximumStops) return false;
+
+    const int count = stops.size();
+    const int start = out.size();
+    out.resize(start + 3 + count * stopBytes);
+
+    uchar* p = reinterpret_cast<uchar*>(out.data()) + start;
+    *p++ = BinaryVersion;
+    qToLittleEndian<quint16>(count, p);
+    p += 2;
+
+    QMap<float, QColor>::const_iterator it = stops.constBegin();
+    for(int s=0;s<count;s++,++it)
+    {
+        quint32 position;
+        const float key = it.key();
+        memcpy(&position, &key, sizeof(position));
+        qToLittleEndian<quint32>(position, p);
+
+        const QColor& color = it.value();
+        p[4] = color.red();
+        p[5] = color.green();
+        p[6] = color.blue();
+        p[7] = color.alpha();
+        p += stopBytes;
+    }
+    return true;
+}
+
+int GradientCodec::fromBinary(const char* data, const int size, QMap<float, QColor>& stops)
+{
+    stops.clear();
+
+    const uchar* p = reinterpret_cast<const uchar*>(data);
+    if(size < 3 || p[0] != BinaryVersion) return 0;
+
+    const int count = qFromLittleEndian<quint16>(p + 1);
+    const int bytes = 3 + count * stopBytes;
+    if(size < bytes) return 0;
+
+    p += 3;
+    for(int s=0;s<count;s++,p+=stopBytes)
+    {
+        const quint32 position = qFromLittleEndian<quint32>(p);
+        float key;
+        memcpy(&key, &position, sizeof(key));
+
+        // a NaN would break the map's ordering
+        if(!qIsFinite(key))
+        {
+            stops.clear();
+            return 0;
+        }
+        stops.insert(key, QColor(p[4], p[5], p[6], p[7]));
+    }
+
+    return bytes;
+}
+
+QMap<float, QColor> GradientCodec::fromBinary(const QByteArray& data)
+{
+    QMap<float, QColor> stops;
+    fromBinary(data.constData(), data.size(), stops);
+    return stops;
+}
+
+QByteArray GradientCodec::encodeList(const QVector<QMap<float, QColor> >& gradients)
+{
+    int bytes = 9;
+    for(int g=0;g<gradients.size();g++)
+        bytes += 3 + gradients[g].size() * stopBytes;
+
+    QByteArray out;
+    out.reserve(bytes);
+    out.append(listMagic, sizeof(listMagic));
+    out.append((char)BinaryVersion);
+
+    uchar count[4];
+    qToLittleEndian<quint32>(gradients.size(), count);
+    out.append(reinterpret_cast<const char*>(count), sizeof(count));
+
+    for(int g=0;g<gradients.size();g++)
+        if(!appendBinary(gradients[g], out)) return QByteArray();
+
+    return out;
+}
+
+bool GradientCodec::decodeList(const QByteArray& data, QVector<QMap<float, QColor> >& gradients)
+{
+    gradients.clear();
+
+    const char* p = data.constData();
+    if(data.size() < 9 || memcmp(p, listMagic, sizeof(listMagic)) != 0 || p[4] != BinaryVersion) return false;
+
+    const quint32 count = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(p + 5));
+    // every gradient takes at least 3 bytes, don't trust a count the data can't hold
+    if(count > (quint32)(data.size() - 9) / 3) return false;
+
+    gradients.resize(count);
+    int offset = 9;
+    for(quint32 g=0;g<count;g++)
+    {
+        const int bytes = fromBinary(p + offset, data.size() - offset, gradients[g]);
+        if(bytes == 0)
+        {
+            gradients.clear();
+            return false;
+        }
+        offset += bytes;
+    }
+
+    return true;
+}
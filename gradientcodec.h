@@ -0,0 +1,59 @@
+#ifndef GRADIENTCODEC_H
+#define GRADIENTCODEC_H
+
+#include <QMap>
+#include <QColor>
+#include <QVector>
+#include <QByteArray>
+#include <QString>
+
+// Reading and writing gradient maps.
+//
+// Text is the format of WidgetGradientEditor::gradientToString(): stops separated by ':', each
+// "position,red,green,blue" with an optional ",alpha". The parser walks the characters once and
+// inserts the stops as it goes, there are no intermediate strings or lists. Malformed stops are
+// skipped, and so are positions that aren't finite. Colors are bounded to [0, 255].
+//
+// The binary format stores 8 bytes per stop: the position as a little endian float and the color
+// as red, green, blue, alpha bytes. A gradient is a version byte, a little endian uint16 stop count
+// and the stops. A list of gradients is the magic "GRDL", a version byte, a little endian uint32
+// count and the gradients back to back.
+class GradientCodec
+{
+public:
+    enum
+    {
+        BinaryVersion = 1,
+        MaximumStops = 0xFFFF // per gradient in the binary format
+    };
+
+    static QString toText(const QMap<float, QColor>& stops);
+    static QMap<float, QColor> fromText(const QString& text);
+    static QMap<float, QColor> fromText(const QByteArray& text); // Latin-1 or UTF-8
+
+    // Parses into stops (which is cleared first). Returns false if anything had to be skipped.
+    static bool parseText(const QChar* text, const int length, QMap<float, QColor>& stops);
+    static bool parseText(const char* text, const int length, QMap<float, QColor>& stops);
+
+    // Reads a decimal number at text[i] and advances i past it, false if there are no digits.
+    // Locale independent, also used by GradientImporter.
+    static bool readNumber(const char* text, const int length, int& i, double& value);
+
+    // Gradients with more than MaximumStops stops can't be written: toBinary() returns an empty
+    // array, appendBinary() false without appending anything.
+    static QByteArray toBinary(const QMap<float, QColor>& stops);
+    static bool appendBinary(const QMap<float, QColor>& stops, QByteArray& out);
+
+    // Decodes the gradient at data, returns the number of bytes it took or 0 on error (truncated,
+    // unknown version, or a position that isn't a finite number).
+    static int fromBinary(const char* data, const int size, QMap<float, QColor>& stops);
+    static QMap<float, QColor> fromBinary(const QByteArray& data);
+
+    // Bulk versions for e.g. one gradient per layer. encodeList() returns an empty array if a
+    // gradient has too many stops, decodeList() false if data is truncated, corrupt or of an
+    // unknown version.
+    static QByteArray encodeList(const QVector<QMap<float, QColor> >& gradients);
+    static bool decodeList(const QByteArray& data, QVector<QMap<float, QColor> >& gradients);
+};
+
+#endif // GRADIENTCODEC_H
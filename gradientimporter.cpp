@@ -0,0 +1,701 @@
+#include "gradientimporter.h"
+#include "gradientcodec.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QtConcurrent>
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+    typedef QVector<GradientImporter::Colormap> Colormaps;
+
+    inline bool isBlank(const char c) { return c == ' ' || c == '\t' || c == '\r'; }
+    inline bool isSpace(const char c) { return isBlank(c) || c == '\n'; }
+    inline bool isLetter(const char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+    inline bool isDigit(const char c) { return c >= '0' && c <= '9'; }
+
+    // rounded and bounded before the cast to int, NaN is 0
+    inline int toByte(const double v) { return !(v > 0.0) ? 0 : v >= 255.0 ? 255 : (int)(v + 0.5); }
+
+    QColor unitColor(const double r, const double g, const double b, const double a = 1.0)
+    {
+        return QColor(toByte(r * 255.0), toByte(g * 255.0), toByte(b * 255.0), toByte(a * 255.0));
+    }
+
+    // a stop with its position as found in the file, normalized once all are known
+    struct RawStop
+    {
+        double position;
+        QColor color;
+    };
+
+    // A second color at an existing position is a hard edge: it starts one float step to the right,
+    // or at 1 the first one ends one step to the left. GradientCodec::toText() writes as many digits
+    // as it takes to keep the two apart.
+    void insertStop(QMap<float, QColor>& stops, float position, const QColor& color)
+    {
+        const QMap<float, QColor>::const_iterator existing = stops.constFind(position);
+        if(existing != stops.constEnd() && existing.value() != color)
+        {
+            if(position < 1.0f) position = nextafterf(position, 2.0f);
+            else stops.insert(nextafterf(position, 0.0f), existing.value());
+        }
+        stops.insert(position, color);
+    }
+
+    QMap<float, QColor> normalized(const QVector<RawStop>& raw)
+    {
+        QMap<float, QColor> stops;
+        if(raw.isEmpty()) return stops;
+
+        double lowest = raw.first().position;
+        double highest = lowest;
+        for(int i=1;i<raw.size();i++)
+        {
+            lowest = qMin(lowest, raw[i].position);
+            highest = qMax(highest, raw[i].position);
+        }
+
+        const double span = highest - lowest;
+        for(int i=0;i<raw.size();i++)
+            insertStop(stops, span > 0.0 ? (float)((raw[i].position - lowest) / span) : 0.0f, raw[i].color);
+        return stops;
+    }
+
+    QColor cptColor(const double* c, const bool hsv)
+    {
+        if(hsv) return QColor::fromHsvF(qBound(0.0, c[0] / 360.0, 1.0), qBound(0.0, c[1], 1.0), qBound(0.0, c[2], 1.0));
+        return QColor(toByte(c[0]), toByte(c[1]), toByte(c[2]));
+    }
+
+    bool parseCpt(const char* d, const int n, Colormaps& colormaps)
+    {
+        bool clean = true;
+        bool hsv = false;
+        QVector<RawStop> raw;
+
+        int i = 0;
+        while(i < n)
+        {
+            int end = i;
+            while(end < n && d[end] != '\n') end++;
+
+            while(i < end && isBlank(d[i])) i++;
+
+            // background, foreground and NaN colors aren't part of the gradient
+            if(i == end || d[i] == 'B' || d[i] == 'F' || d[i] == 'N')
+            {
+                i = end + 1;
+                continue;
+            }
+
+            // only the color model matters, e.g. "# COLOR_MODEL = +HSV"
+            if(d[i] == '#')
+            {
+                const QByteArray comment = QByteArray::fromRawData(d + i, end - i);
+                if(comment.contains("COLOR_MODEL")) hsv = comment.contains("HSV") || comment.contains("hsv");
+                i = end + 1;
+                continue;
+            }
+
+            // Up to eight numbers, whatever follows (annotation flags, labels) is ignored. A '/' or
+            // '-' right after a number separates color components, as in r/g/b or h-s-v.
+            double fields[8];
+            int count = 0;
+            bool separated = false;
+            while(count < 8)
+            {
+                while(i < end && isBlank(d[i])) i++;
+                if(!GradientCodec::readNumber(d, end, i, fields[count])) break;
+                count++;
+
+                if(i < end && (d[i] == '/' || d[i] == '-'))
+                {
+                    separated = true;
+                    i++;
+                }
+            }
+            i = end + 1;
+
+            if(count == 8)
+            {
+                // z0 color0 z1 color1
+                const RawStop from = {fields[0], cptColor(fields + 1, hsv)};
+                const RawStop to = {fields[4], cptColor(fields + 5, hsv)};
+                raw.append(from);
+                raw.append(to);
+            }
+            else if(count == 4 && separated)
+            {
+                // categorical: z r/g/b
+                const RawStop stop = {fields[0], cptColor(fields + 1, hsv)};
+                raw.append(stop);
+            }
+            else if(count == 4)
+            {
+                // z0 gray0 z1 gray1
+                const RawStop from = {fields[0], QColor(toByte(fields[1]), toByte(fields[1]), toByte(fields[1]))};
+                const RawStop to = {fields[2], QColor(toByte(fields[3]), toByte(fields[3]), toByte(fields[3]))};
+                raw.append(from);
+                raw.append(to);
+            }
+            else
+            {
+                clean = false; // color names, patterns
+            }
+        }
+
+        if(raw.isEmpty()) return false;
+        colormaps.append(GradientImporter::Colormap(QString(), normalized(raw)));
+        return clean;
+    }
+
+    // attribute values are UTF-8 with the predefined entities
+    QString xmlText(const char* s, const int length)
+    {
+        QString text = QString::fromUtf8(s, length);
+        if(!memchr(s, '&', length)) return text;
+
+        text.replace("&lt;", "<");
+        text.replace("&gt;", ">");
+        text.replace("&quot;", "\"");
+        text.replace("&apos;", "'");
+        text.replace("&amp;", "&");
+        return text;
+    }
+
+    bool parseParaViewXml(const char* d, const int n, Colormaps& colormaps)
+    {
+        bool clean = true;
+        bool inColorMap = false;
+        QString name;
+        QVector<RawStop> raw;
+
+        int i = 0;
+        while(i < n)
+        {
+            const char* open = static_cast<const char*>(memchr(d + i, '<', n - i));
+            if(!open) break;
+            i = open - d + 1;
+
+            if(i + 2 < n && d[i] == '!' && d[i + 1] == '-' && d[i + 2] == '-')
+            {
+                const int close = QByteArray::fromRawData(d + i, n - i).indexOf("-->");
+                if(close < 0) break;
+                i += close + 3;
+                continue;
+            }
+
+            const bool closing = i < n && d[i] == '/';
+            if(closing) i++;
+            const int tagStart = i;
+            while(i < n && !isSpace(d[i]) && d[i] != '/' && d[i] != '>') i++;
+            const QByteArray tag = QByteArray::fromRawData(d + tagStart, i - tagStart);
+
+            const bool colorMap = tag == "ColorMap";
+            const bool point = tag == "Point" && inColorMap && !closing;
+            if(colorMap && !closing)
+            {
+                name.clear();
+                raw.clear();
+            }
+
+            // attributes, read for every element so quoted '>' don't end it early
+            double channels[4] = {0.0, 0.0, 0.0, 1.0}; // r, g, b, o
+            double x = 0.0;
+            int found = 0; // bits for x, r, g, b
+            bool selfClosing = false;
+            while(i < n && d[i] != '>')
+            {
+                if(d[i] == '/')
+                {
+                    selfClosing = true;
+                    i++;
+                    continue;
+                }
+                if(isSpace(d[i]) || d[i] == '?')
+                {
+                    i++;
+                    continue;
+                }
+
+                const int keyStart = i;
+                while(i < n && d[i] != '=' && !isSpace(d[i]) && d[i] != '>' && d[i] != '/') i++;
+                const QByteArray key = QByteArray::fromRawData(d + keyStart, i - keyStart);
+
+                while(i < n && isSpace(d[i])) i++;
+                if(i >= n || d[i] != '=') continue;
+                i++;
+                while(i < n && isSpace(d[i])) i++;
+                if(i >= n || (d[i] != '"' && d[i] != '\''))
+                {
+                    clean = false;
+                    continue;
+                }
+
+                const char quote = d[i++];
+                const int valueStart = i;
+                const char* valueEnd = static_cast<const char*>(memchr(d + i, quote, n - i));
+                if(!valueEnd)
+                {
+                    clean = false;
+                    i = n;
+                    break;
+                }
+                const int valueLength = valueEnd - (d + valueStart);
+                i = valueEnd - d + 1;
+
+                if(colorMap && !closing && key == "name")
+                {
+                    name = xmlText(d + valueStart, valueLength);
+                }
+                else if(point && key.size() == 1)
+                {
+                    int j = valueStart;
+                    while(j < valueStart + valueLength && isSpace(d[j])) j++;
+                    double value = 0.0;
+                    if(!GradientCodec::readNumber(d, valueStart + valueLength, j, value))
+                    {
+                        clean = false;
+                        continue;
+                    }
+
+                    switch(key[0])
+                    {
+                    case 'x': x = value; found |= 1; break;
+                    case 'r': channels[0] = value; found |= 2; break;
+                    case 'g': channels[1] = value; found |= 4; break;
+                    case 'b': channels[2] = value; found |= 8; break;
+                    case 'o': channels[3] = value; break;
+                    }
+                }
+            }
+            i++; // '>'
+
+            if(point)
+            {
+                if(found == 15)
+                {
+                    const RawStop stop = {x, unitColor(channels[0], channels[1], channels[2], channels[3])};
+                    raw.append(stop);
+                }
+                else
+                {
+                    clean = false;
+                }
+            }
+            else if(colorMap && !closing)
+            {
+                inColorMap = !selfClosing;
+            }
+            else if(colorMap && inColorMap)
+            {
+                if(raw.isEmpty()) clean = false;
+                else colormaps.append(GradientImporter::Colormap(name, normalized(raw)));
+                inColorMap = false;
+            }
+        }
+
+        return clean && !inColorMap;
+    }
+
+    // i is at the opening quote and ends up after the closing one. Returns the length of the
+    // contents, escapes included.
+    int scanString(const char* d, const int n, int& i)
+    {
+        const int start = ++i;
+        while(i < n && d[i] != '"') i += d[i] == '\\' ? 2 : 1;
+        const int length = qMin(i, n) - start;
+        i++;
+        return length;
+    }
+
+    QString jsonText(const char* s, const int length)
+    {
+        if(!memchr(s, '\\', length)) return QString::fromUtf8(s, length);
+
+        QByteArray utf8;
+        utf8.reserve(length);
+        for(int i=0;i<length;i++)
+        {
+            if(s[i] != '\\' || i + 1 >= length)
+            {
+                utf8.append(s[i]);
+                continue;
+            }
+
+            const char c = s[++i];
+            switch(c)
+            {
+            case 'b': utf8.append('\b'); break;
+            case 'f': utf8.append('\f'); break;
+            case 'n': utf8.append('\n'); break;
+            case 'r': utf8.append('\r'); break;
+            case 't': utf8.append('\t'); break;
+            case 'u':
+                if(i + 4 < length)
+                {
+                    bool ok = false;
+                    QString unit(QChar(QByteArray(s + i + 1, 4).toUShort(&ok, 16)));
+                    i += 4;
+
+                    // characters beyond the BMP are two escapes, a surrogate pair
+                    if(ok && unit[0].isHighSurrogate() && i + 6 < length && s[i + 1] == '\\' && s[i + 2] == 'u')
+                    {
+                        bool lowOk = false;
+                        const QChar low(QByteArray(s + i + 3, 4).toUShort(&lowOk, 16));
+                        if(lowOk && low.isLowSurrogate())
+                        {
+                            unit.append(low);
+                            i += 6;
+                        }
+                    }
+                    if(ok) utf8.append(unit.toUtf8());
+                }
+                break;
+            default: utf8.append(c); // '"', '\\', '/'
+            }
+        }
+        return QString::fromUtf8(utf8);
+    }
+
+    // Tracks objects only. A colormap is any object with an "RGBPoints" member, its name the "Name"
+    // member of the same object, names of nested objects don't count.
+    bool parseParaViewJson(const char* d, const int n, Colormaps& colormaps)
+    {
+        bool clean = true;
+        QVector<QString> names; // per open object, the innermost last
+        int pointsDepth = -1;
+        QVector<RawStop> raw;
+
+        int i = 0;
+        while(i < n)
+        {
+            const char c = d[i];
+            if(c == '{')
+            {
+                names.append(QString());
+                i++;
+                continue;
+            }
+            if(c == '}')
+            {
+                if(!names.isEmpty())
+                {
+                    if(pointsDepth == names.size())
+                    {
+                        colormaps.append(GradientImporter::Colormap(names.last(), normalized(raw)));
+                        raw.clear();
+                        pointsDepth = -1;
+                    }
+                    names.removeLast();
+                }
+                i++;
+                continue;
+            }
+            if(c != '"')
+            {
+                i++;
+                continue;
+            }
+
+            // a string is a key if a ':' follows
+            const int keyStart = i + 1;
+            const int keyLength = scanString(d, n, i);
+            int j = i;
+            while(j < n && isSpace(d[j])) j++;
+            if(j >= n || d[j] != ':') continue;
+
+            i = j + 1;
+            while(i < n && isSpace(d[i])) i++;
+            const QByteArray key = QByteArray::fromRawData(d + keyStart, keyLength);
+
+            if(key == "Name" && i < n && d[i] == '"')
+            {
+                const int valueStart = i + 1;
+                const int valueLength = scanString(d, n, i);
+                if(!names.isEmpty()) names.last() = jsonText(d + valueStart, valueLength);
+            }
+            else if(key == "RGBPoints" && i < n && d[i] == '[')
+            {
+                // x, r, g, b quadruples
+                i++;
+                double fields[4];
+                int count = 0;
+                while(i < n && d[i] != ']')
+                {
+                    if(isSpace(d[i]) || d[i] == ',')
+                    {
+                        i++;
+                        continue;
+                    }
+                    if(!GradientCodec::readNumber(d, n, i, fields[count]))
+                    {
+                        clean = false;
+                        while(i < n && d[i] != ',' && d[i] != ']') i++;
+                        continue;
+                    }
+                    if(++count == 4)
+                    {
+                        const RawStop stop = {fields[0], unitColor(fields[1], fields[2], fields[3])};
+                        raw.append(stop);
+                        count = 0;
+                    }
+                }
+                if(count != 0) clean = false;
+                i++; // ']'
+                pointsDepth = names.size();
+            }
+        }
+
+        return clean;
+    }
+
+    // Rows end at a newline or ']', so both one row per line and [[r, g, b], ...] on one line work.
+    // Identifiers (as in "_viridis_data = [") and '#' comments are skipped.
+    bool parseTable(const char* d, const int n, Colormaps& colormaps)
+    {
+        bool clean = true;
+        QVector<double> rows; // r, g, b, a (-1 if none) per row
+        bool bytes = false; // [0, 255] rather than [0, 1]
+        double row[4];
+        int count = 0;
+
+        int i = 0;
+        while(i <= n)
+        {
+            const char c = i < n ? d[i] : '\n';
+            if(c == '\n' || c == ']')
+            {
+                if(count == 3 || count == 4)
+                {
+                    for(int k=0;k<count;k++) bytes |= row[k] > 1.0;
+                    rows << row[0] << row[1] << row[2] << (count == 4 ? row[3] : -1.0);
+                }
+                else if(count != 0)
+                {
+                    clean = false;
+                }
+                count = 0;
+                i++;
+            }
+            else if(c == '#')
+            {
+                while(i < n && d[i] != '\n') i++;
+            }
+            else if(isLetter(c))
+            {
+                while(i < n && (isLetter(d[i]) || isDigit(d[i]))) i++;
+            }
+            else if(isDigit(c) || c == '.' || c == '-' || c == '+')
+            {
+                const int start = i;
+                double value = 0.0;
+                if(!GradientCodec::readNumber(d, n, i, value))
+                {
+                    i = start + 1;
+                    continue;
+                }
+                if(count < 4) row[count] = value;
+                count++; // more than four spoils the row
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        const int stops = rows.size() / 4;
+        if(stops == 0) return false;
+
+        const double scale = bytes ? 1.0 : 255.0;
+        QMap<float, QColor> gradient;
+        for(int s=0;s<stops;s++)
+        {
+            const double* c = rows.constData() + s * 4;
+            const QColor color(toByte(c[0] * scale), toByte(c[1] * scale), toByte(c[2] * scale), c[3] < 0.0 ? 255 : toByte(c[3] * scale));
+            gradient.insert(gradient.constEnd(), stops > 1 ? (float)s / (stops - 1) : 0.0f, color);
+        }
+
+        colormaps.append(GradientImporter::Colormap(QString(), gradient));
+        return clean;
+    }
+
+    // premultiplied, like GradientRasterizer interpolates
+    struct SimplifyPoint
+    {
+        float position;
+        float c[4];
+    };
+
+    // whether the points strictly between first and last lie within tolerance of the line between them
+    bool onLine(const QVector<SimplifyPoint>& points, const int first, const int last, const float tolerance)
+    {
+        const SimplifyPoint& a = points[first];
+        const SimplifyPoint& b = points[last];
+        for(int p=first+1;p<last;p++)
+        {
+            const float t = (points[p].position - a.position) / (b.position - a.position);
+            for(int k=0;k<4;k++)
+                if(fabsf(a.c[k] + (b.c[k] - a.c[k]) * t - points[p].c[k]) > tolerance) return false;
+        }
+        return true;
+    }
+}
+
+GradientImporter::Format GradientImporter::formatOfFileName(const QString& fileName)
+{
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    if(suffix == "cpt") return Cpt;
+    if(suffix == "xml") return ParaViewXml;
+    if(suffix == "json") return ParaViewJson;
+    return UnknownFormat;
+}
+
+GradientImporter::Format GradientImporter::detect(const char* data, const int size)
+{
+    int i = 0;
+    if(size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) i = 3; // UTF-8 byte order mark
+    while(i < size && isSpace(data[i])) i++;
+    if(i >= size) return UnknownFormat;
+
+    const char c = data[i];
+    if(c == '<') return ParaViewXml;
+    if(c == '{') return ParaViewJson;
+    if(c == '[')
+    {
+        // an array of objects is ParaView's, an array of arrays a table
+        int j = i + 1;
+        while(j < size && isSpace(data[j])) j++;
+        return j < size && data[j] == '{' ? ParaViewJson : Table;
+    }
+    if(c == '#') return Cpt;
+    if(isLetter(c)) return Table;
+
+    // A cpt line has eight numbers or '/' separated colors, its gray form four with the colors
+    // usually beyond 1. A table row has three or four numbers.
+    int count = 0;
+    bool slash = false;
+    bool beyondOne = false;
+    while(i < size && data[i] != '\n')
+    {
+        const int start = i;
+        double value = 0.0;
+        if(GradientCodec::readNumber(data, size, i, value))
+        {
+            count++;
+            beyondOne |= value > 1.0;
+            continue;
+        }
+        slash |= data[start] == '/';
+        i = start + 1;
+    }
+
+    if(slash || count >= 8 || (count == 4 && beyondOne)) return Cpt;
+    if(count == 3 || count == 4) return Table;
+    return UnknownFormat;
+}
+
+bool GradientImporter::parse(const char* data, const int size, const Format format, QVector<Colormap>& colormaps)
+{
+    switch(format == UnknownFormat ? detect(data, size) : format)
+    {
+    case Cpt: return parseCpt(data, size, colormaps);
+    case ParaViewXml: return parseParaViewXml(data, size, colormaps);
+    case ParaViewJson: return parseParaViewJson(data, size, colormaps);
+    case Table: return parseTable(data, size, colormaps);
+    default: return false;
+    }
+}
+
+QVector<GradientImporter::Colormap> GradientImporter::fromData(const QByteArray& data, Format format)
+{
+    QVector<Colormap> colormaps;
+    parse(data.constData(), data.size(), format, colormaps);
+    return colormaps;
+}
+
+QVector<GradientImporter::Colormap> GradientImporter::fromFile(const QString& fileName, Format format)
+{
+    QVector<Colormap> colormaps;
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly) || file.size() > INT_MAX) return colormaps;
+    if(format == UnknownFormat) format = formatOfFileName(fileName);
+
+    // mapped if possible, read otherwise (pipes, some file systems). QFile unmaps on destruction.
+    int size = file.size();
+    const char* data = size > 0 ? reinterpret_cast<const char*>(file.map(0, size)) : nullptr;
+    QByteArray buffer;
+    if(!data)
+    {
+        buffer = file.readAll();
+        data = buffer.constData();
+        size = buffer.size();
+    }
+    parse(data, size, format, colormaps);
+
+    const QString baseName = QFileInfo(fileName).completeBaseName();
+    for(int i=0;i<colormaps.size();i++)
+        if(colormaps[i].name.isEmpty()) colormaps[i].name = baseName;
+
+    return colormaps;
+}
+
+QVector<GradientImporter::Colormap> GradientImporter::fromFiles(const QStringList& fileNames)
+{
+    QVector<int> indices(fileNames.size());
+    for(int i=0;i<indices.size();i++) indices[i] = i;
+
+    // data() detaches, so call it once here and not from the workers
+    QVector<QVector<Colormap> > perFile(fileNames.size());
+    QVector<Colormap>* results = perFile.data();
+    QtConcurrent::blockingMap(indices, [&](const int i)
+    {
+        results[i] = fromFile(fileNames.at(i));
+    });
+
+    QVector<Colormap> colormaps;
+    for(int i=0;i<perFile.size();i++) colormaps += perFile.at(i);
+    return colormaps;
+}
+
+QMap<float, QColor> GradientImporter::simplify(const QMap<float, QColor>& stops, const float tolerance)
+{
+    if(stops.size() <= 2) return stops;
+
+    QVector<SimplifyPoint> points;
+    QVector<QColor> colors;
+    points.reserve(stops.size());
+    colors.reserve(stops.size());
+    QMapIterator<float, QColor> i(stops);
+    while(i.hasNext())
+    {
+        i.next();
+        const QColor& color = i.value();
+        const float alpha = color.alphaF();
+        const SimplifyPoint point = {i.key(), {color.red() * alpha, color.green() * alpha, color.blue() * alpha, (float)color.alpha()}};
+        points.append(point);
+        colors.append(color);
+    }
+
+    // Greedy: the segment from the last kept stop grows as long as everything it skips stays on
+    // its line, then the stop before the one that broke it is kept.
+    QMap<float, QColor> simplified;
+    simplified.insert(points.first().position, colors.first());
+    int anchor = 0;
+    for(int last=2;last<points.size();last++)
+    {
+        if(onLine(points, anchor, last, tolerance)) continue;
+
+        anchor = last - 1;
+        simplified.insert(simplified.constEnd(), points[anchor].position, colors[anchor]);
+    }
+    simplified.insert(simplified.constEnd(), points.last().position, colors.last());
+
+    return simplified;
+}
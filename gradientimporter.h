@@ -0,0 +1,66 @@
+#ifndef GRADIENTIMPORTER_H
+#define GRADIENTIMPORTER_H
+
+#include <QMap>
+#include <QColor>
+#include <QVector>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+
+// Reading colormaps written by other programs, into the stops the gradient editor and
+// FloatingGradientRangeSlider::slotSetColorMap() use:
+//
+//   Cpt           GMT color palette tables, "z0 r g b z1 r g b" segments, also with r/g/b, gray or
+//                 h-s-v colors ("# COLOR_MODEL = HSV"). B, F and N lines are ignored.
+//   ParaViewXml   <ColorMap name=".."> elements with <Point x r g b o/> children, any number of them.
+//   ParaViewJson  ParaView's preset export, [{"Name": .., "RGBPoints": [x, r, g, b, ...]}, ...].
+//                 Maps in other color spaces are taken as RGB between their points.
+//   Table         one color per row, three or four numbers in [0, 1] or [0, 255], like matplotlib's
+//                 listed colormaps. Rows end at a newline or ']', identifiers and commas are skipped.
+//
+// Like GradientCodec::parseText(), the parsers walk the bytes once and insert the stops as they
+// go, there is no DOM and no per-line or per-token string. Files are memory-mapped. Positions are
+// normalized to [0, 1], a hard edge (two colors at one position) becomes two stops one float step
+// apart.
+class GradientImporter
+{
+public:
+    enum Format
+    {
+        UnknownFormat,
+        Cpt,
+        ParaViewXml,
+        ParaViewJson,
+        Table
+    };
+
+    struct Colormap
+    {
+        Colormap() { }
+        Colormap(const QString& name, const QMap<float, QColor>& stops) : name(name), stops(stops) { }
+
+        QString name; // empty if the format has none, fromFile() then uses the file's base name
+        QMap<float, QColor> stops;
+    };
+
+    static Format formatOfFileName(const QString& fileName); // by extension, UnknownFormat if unsure
+    static Format detect(const char* data, const int size); // by looking at the first bytes
+
+    // Appends the colormaps in data. Returns false if anything had to be skipped.
+    static bool parse(const char* data, const int size, const Format format, QVector<Colormap>& colormaps);
+
+    static QVector<Colormap> fromData(const QByteArray& data, Format format = UnknownFormat);
+    static QVector<Colormap> fromFile(const QString& fileName, Format format = UnknownFormat);
+
+    // Reads the files in parallel, the result is in the order of fileNames
+    static QVector<Colormap> fromFiles(const QStringList& fileNames);
+
+    // Drops stops whose color is within tolerance (per channel, 0-255) of the straight line between
+    // the stops kept around them. Premultiplied like GradientRasterizer, so with the default
+    // tolerance the rendered gradient doesn't change by more than rounding. A resampled 256 entry
+    // table usually ends up with a few dozen stops.
+    static QMap<float, QColor> simplify(const QMap<float, QColor>& stops, const float tolerance = 0.5f);
+};
+
+#endif // GRADIENTIMPORTER_H
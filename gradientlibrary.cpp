@@ -0,0 +1,258 @@
+#include "gradientlibrary.h"
+#include "gradientcodec.h"
+#include "gradientrasterizer.h"
+
+#include <QFile>
+#include <QtEndian>
+
+#include <algorithm>
+#include <string.h>
+
+namespace
+{
+    const char magic[4] = {'G', 'R', 'D', 'B'};
+    const quint32 fileVersion = 1;
+    const int headerBytes = 32;
+    const int recordBytes = 32;
+
+    // record fields
+    const int recordId = 0;
+    const int recordNameLength = 4;
+    const int recordNameOffset = 8;
+    const int recordGradientOffset = 16;
+    const int recordGradientBytes = 24;
+    const int recordThumbnail = 28;
+
+    inline quint32 read32(const uchar* p) { return qFromLittleEndian<quint32>(p); }
+    inline quint64 read64(const uchar* p) { return qFromLittleEndian<quint64>(p); }
+
+    void append32(QByteArray& out, const quint32 value)
+    {
+        uchar bytes[4];
+        qToLittleEndian<quint32>(value, bytes);
+        out.append(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+    }
+
+    void append64(QByteArray& out, const quint64 value)
+    {
+        uchar bytes[8];
+        qToLittleEndian<quint64>(value, bytes);
+        out.append(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+    }
+
+    void set32(QByteArray& out, const int offset, const quint32 value)
+    {
+        qToLittleEndian<quint32>(value, reinterpret_cast<uchar*>(out.data()) + offset);
+    }
+
+    void set64(QByteArray& out, const int offset, const quint64 value)
+    {
+        qToLittleEndian<quint64>(value, reinterpret_cast<uchar*>(out.data()) + offset);
+    }
+}
+
+GradientLibrary::GradientLibrary() :
+    mFile(nullptr),
+    mData(nullptr),
+    mSize(0),
+    mCount(0),
+    mThumbnailWidth(0),
+    mRecords(nullptr),
+    mNameIndex(nullptr)
+{
+}
+
+GradientLibrary::~GradientLibrary()
+{
+    close();
+}
+
+bool GradientLibrary::open(const QString& fileName)
+{
+    close();
+
+    mFile = new QFile(fileName);
+    if(!mFile->open(QIODevice::ReadOnly) || mFile->size() < headerBytes)
+    {
+        close();
+        return false;
+    }
+
+    mSize = mFile->size();
+    mData = mFile->map(0, mSize);
+    if(!mData || memcmp(mData, magic, sizeof(magic)) != 0 || read32(mData + 4) != fileVersion)
+    {
+        close();
+        return false;
+    }
+
+    // only check that the tables fit, the data they point to is checked on access
+    const quint64 count = read32(mData + 8);
+    const quint64 nameIndexOffset = read64(mData + 16);
+    if(headerBytes + count * recordBytes > (quint64)mSize || nameIndexOffset + count * 4 > (quint64)mSize)
+    {
+        close();
+        return false;
+    }
+
+    mCount = count;
+    mThumbnailWidth = read32(mData + 12);
+    mRecords = mData + headerBytes;
+    mNameIndex = mData + nameIndexOffset;
+    return true;
+}
+
+void GradientLibrary::close()
+{
+    // unmapped by QFile
+    delete mFile;
+    mFile = nullptr;
+    mData = nullptr;
+    mSize = 0;
+    mCount = 0;
+    mThumbnailWidth = 0;
+    mRecords = nullptr;
+    mNameIndex = nullptr;
+}
+
+const uchar* GradientLibrary::record(const int index) const
+{
+    return mRecords + (qint64)index * recordBytes;
+}
+
+int GradientLibrary::indexOfId(const quint32 id) const
+{
+    int lo = 0, hi = mCount;
+    while(lo < hi)
+    {
+        const int mid = lo + (hi - lo) / 2;
+        if(read32(record(mid) + recordId) < id) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < mCount && read32(record(lo) + recordId) == id ? lo : -1;
+}
+
+int GradientLibrary::indexOfName(const QByteArray& utf8Name) const
+{
+    int lo = 0, hi = mCount;
+    while(lo < hi)
+    {
+        const int mid = lo + (hi - lo) / 2;
+        if(nameUtf8(read32(mNameIndex + mid * 4)) < utf8Name) lo = mid + 1;
+        else hi = mid;
+    }
+    if(lo == mCount) return -1;
+
+    const int index = read32(mNameIndex + lo * 4);
+    return nameUtf8(index) == utf8Name ? index : -1;
+}
+
+quint32 GradientLibrary::id(const int index) const
+{
+    if(index < 0 || index >= mCount) return 0;
+    return read32(record(index) + recordId);
+}
+
+QByteArray GradientLibrary::nameUtf8(const int index) const
+{
+    if(index < 0 || index >= mCount) return QByteArray();
+
+    const quint64 offset = read64(record(index) + recordNameOffset);
+    const quint64 length = read32(record(index) + recordNameLength);
+    if(offset + length > (quint64)mSize) return QByteArray();
+
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(mData + offset), length);
+}
+
+QMap<float, QColor> GradientLibrary::stops(const int index) const
+{
+    QMap<float, QColor> result;
+    if(index < 0 || index >= mCount) return result;
+
+    const quint64 offset = read64(record(index) + recordGradientOffset);
+    const quint64 bytes = read32(record(index) + recordGradientBytes);
+    if(offset + bytes > (quint64)mSize) return result;
+
+    GradientCodec::fromBinary(reinterpret_cast<const char*>(mData + offset), bytes, result);
+    return result;
+}
+
+QImage GradientLibrary::thumbnail(const int index) const
+{
+    if(index < 0 || index >= mCount || mThumbnailWidth <= 0) return QImage();
+
+    const quint64 offset = (quint64)read32(record(index) + recordThumbnail) * 4;
+    if(offset == 0 || offset + mThumbnailWidth * 4 > (quint64)mSize) return QImage();
+
+    // wraps the mapped bytes read-only, QImage copies only if someone writes to it
+    return QImage(mData + offset, mThumbnailWidth, 1, mThumbnailWidth * 4, QImage::Format_ARGB32_Premultiplied);
+}
+
+bool GradientLibrary::write(const QString& fileName, const QVector<Preset>& presets, const int thumbnailWidth)
+{
+    QVector<Preset> sorted = presets;
+    std::sort(sorted.begin(), sorted.end(), [](const Preset& a, const Preset& b) { return a.id < b.id; });
+    for(int i=1;i<sorted.size();i++)
+        if(sorted[i].id == sorted[i - 1].id) return false;
+
+    const int count = sorted.size();
+    QVector<QByteArray> names(count);
+    for(int i=0;i<count;i++)
+        names[i] = sorted[i].name.toUtf8();
+
+    QVector<quint32> byName(count);
+    for(int i=0;i<count;i++)
+        byName[i] = i;
+    std::sort(byName.begin(), byName.end(), [&](const quint32 a, const quint32 b) { return names[a] < names[b]; });
+
+    QByteArray out;
+    out.append(magic, sizeof(magic));
+    append32(out, fileVersion);
+    append32(out, count);
+    append32(out, qMax(0, thumbnailWidth));
+    append64(out, 0); // name index offset, set below
+    append64(out, 0);
+
+    const int recordsOffset = out.size();
+    out.append(QByteArray(count * recordBytes, '\0'));
+
+    set64(out, 16, out.size());
+    for(int i=0;i<count;i++)
+        append32(out, byName[i]);
+
+    for(int i=0;i<count;i++)
+    {
+        const int r = recordsOffset + i * recordBytes;
+        set32(out, r + recordId, sorted[i].id);
+
+        set32(out, r + recordNameLength, names[i].size());
+        set64(out, r + recordNameOffset, out.size());
+        out.append(names[i]);
+
+        const int gradientOffset = out.size();
+        if(!GradientCodec::appendBinary(sorted[i].stops, out)) return false;
+        set64(out, r + recordGradientOffset, gradientOffset);
+        set32(out, r + recordGradientBytes, out.size() - gradientOffset);
+    }
+
+    // thumbnails last and 4 byte aligned, so they can be wrapped as images in place
+    if(thumbnailWidth > 0)
+    {
+        for(int i=0;i<count;i++)
+        {
+            while(out.size() % 4) out.append('\0');
+
+            const int r = recordsOffset + i * recordBytes;
+            set32(out, r + recordThumbnail, out.size() / 4);
+
+            const QImage strip = GradientRasterizer::rasterize(sorted[i].stops, QSize(thumbnailWidth, 1), true);
+            const uint32_t* pixels = reinterpret_cast<const uint32_t*>(strip.constScanLine(0));
+            for(int x=0;x<thumbnailWidth;x++)
+                append32(out, pixels[x]);
+        }
+    }
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly)) return false;
+    return file.write(out) == out.size();
+}
@@ -0,0 +1,80 @@
+#ifndef GRADIENTLIBRARY_H
+#define GRADIENTLIBRARY_H
+
+#include <QMap>
+#include <QColor>
+#include <QVector>
+#include <QString>
+#include <QByteArray>
+#include <QImage>
+
+class QFile;
+
+// A read-only collection of named gradients (thousands of scientific colormaps, say) in one file,
+// memory-mapped on open(). Opening only checks the header, so it costs the same for ten presets
+// as for ten thousand, and the OS pages in what is actually used.
+//
+// Lookups work on the mapping in place: by id and by name are binary searches over sorted
+// indices, names are returned as QByteArrays on the mapped bytes, and thumbnail() wraps a
+// pre-rendered strip without copying it. Everything returned that way is valid until close().
+//
+// File layout, all little endian:
+//   header    "GRDB", version, count, thumbnail width (uint32 each), 16 bytes of offsets
+//             (uint64 name index, uint64 reserved)
+//   records   count x {uint32 id, uint32 name length, uint64 name offset, uint64 gradient offset,
+//             uint32 gradient bytes, uint32 thumbnail offset / 4}, sorted by id
+//   name idx  count x uint32 record index, sorted by name
+//   data      UTF-8 names, gradients in GradientCodec's binary format, and thumbnails as
+//             thumbnail width ARGB32_Premultiplied pixels each
+class GradientLibrary
+{
+public:
+    struct Preset
+    {
+        Preset() : id(0) { }
+        Preset(const quint32 id, const QString& name, const QMap<float, QColor>& stops) : id(id), name(name), stops(stops) { }
+
+        quint32 id;
+        QString name;
+        QMap<float, QColor> stops;
+    };
+
+    GradientLibrary();
+    ~GradientLibrary();
+
+    bool open(const QString& fileName);
+    void close();
+    bool isOpen() const { return mData != nullptr; }
+
+    // presets are numbered 0 to count() - 1 in id order
+    int count() const { return mCount; }
+    int indexOfId(const quint32 id) const;
+    int indexOfName(const QByteArray& utf8Name) const;
+    int indexOfName(const QString& name) const { return indexOfName(name.toUtf8()); }
+
+    quint32 id(const int index) const;
+    QByteArray nameUtf8(const int index) const; // no copy
+    QString name(const int index) const { return QString::fromUtf8(nameUtf8(index)); }
+    QMap<float, QColor> stops(const int index) const;
+    QImage thumbnail(const int index) const; // no copy, null if the file has no thumbnails
+    int thumbnailWidth() const { return mThumbnailWidth; }
+
+    // Writes a library, rendering the thumbnails with GradientRasterizer. Ids must be unique, and
+    // gradients can have at most GradientCodec::MaximumStops stops.
+    static bool write(const QString& fileName, const QVector<Preset>& presets, const int thumbnailWidth = 256);
+
+private:
+    Q_DISABLE_COPY(GradientLibrary)
+
+    const uchar* record(const int index) const;
+
+    QFile* mFile;
+    const uchar* mData;
+    qint64 mSize;
+    int mCount;
+    int mThumbnailWidth;
+    const uchar* mRecords;
+    const uchar* mNameIndex;
+};
+
+#endif // GRADIENTLIBRARY_H
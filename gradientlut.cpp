@@ -0,0 +1,243 @@
+#include "gradientlut.h"
+#include "simd.h"
+
+#include <math.h>
+
+namespace
+{
+    struct Stop
+    {
+        float position;
+        float r, g, b, a;
+    };
+
+    Stop makeStop(const float position, const QColor& color)
+    {
+        const Stop stop = {position, (float)color.red(), (float)color.green(), (float)color.blue(), (float)color.alpha()};
+        return stop;
+    }
+
+    QVector<Stop> validStops(const QMap<float, QColor>& stops)
+    {
+        QVector<Stop> result;
+        result.reserve(stops.size());
+
+        QMapIterator<float, QColor> i(stops);
+        while(i.hasNext())
+        {
+            i.next();
+            // QGradient::setColorAt() ignores these, so do we
+            if(i.key() < 0.0f || i.key() > 1.0f) continue;
+            result.append(makeStop(i.key(), i.value()));
+        }
+
+        // same default as QGradient: black to white
+        if(result.isEmpty())
+        {
+            result.append(makeStop(0.0f, Qt::black));
+            result.append(makeStop(1.0f, Qt::white));
+        }
+
+        return result;
+    }
+
+    inline uint32_t pack(const float r, const float g, const float b, const float a)
+    {
+        return qRgba((int)(r + 0.5f), (int)(g + 0.5f), (int)(b + 0.5f), (int)(a + 0.5f));
+    }
+
+    // All kernels compute index = clamp((x - lo) * scale + 0.5, 0, maxIndex), with NaN ending up at 0.
+
+    void sampleScalar(const uint32_t* table, const int maxIndex, const float* in, uint32_t* out, const size_t n, const float lo, const float scale)
+    {
+        for(size_t i=0;i<n;i++)
+        {
+            float f = (in[i] - lo) * scale + 0.5f;
+            if(!(f > 0.0f)) f = 0.0f;
+            if(f > maxIndex) f = maxIndex;
+            out[i] = table[(int)f];
+        }
+    }
+
+#ifdef RANGESLIDERS_SSE2
+    void sampleSse2(const uint32_t* table, const int maxIndex, const float* in, uint32_t* out, const size_t n, const float lo, const float scale)
+    {
+        const __m128 vLo = _mm_set1_ps(lo);
+        const __m128 vScale = _mm_set1_ps(scale);
+        const __m128 vHalf = _mm_set1_ps(0.5f);
+        const __m128 vZero = _mm_setzero_ps();
+        const __m128 vMax = _mm_set1_ps((float)maxIndex);
+
+        size_t i = 0;
+        for(;i+4<=n;i+=4)
+        {
+            __m128 f = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(in + i), vLo), vScale), vHalf);
+            f = _mm_min_ps(_mm_max_ps(f, vZero), vMax); // maxps returns its second operand for NaN
+
+            // there's no gather in SSE2, so look the four entries up one by one
+            int32_t index[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(index), _mm_cvttps_epi32(f));
+            out[i + 0] = table[index[0]];
+            out[i + 1] = table[index[1]];
+            out[i + 2] = table[index[2]];
+            out[i + 3] = table[index[3]];
+        }
+
+        sampleScalar(table, maxIndex, in + i, out + i, n - i, lo, scale);
+    }
+#endif
+
+#ifdef RANGESLIDERS_AVX2
+    RANGESLIDERS_TARGET_AVX2 void sampleAvx2(const uint32_t* table, const int maxIndex, const float* in, uint32_t* out, const size_t n, const float lo, const float scale)
+    {
+        const __m256 vLo = _mm256_set1_ps(lo);
+        const __m256 vScale = _mm256_set1_ps(scale);
+        const __m256 vHalf = _mm256_set1_ps(0.5f);
+        const __m256 vZero = _mm256_setzero_ps();
+        const __m256 vMax = _mm256_set1_ps((float)maxIndex);
+
+        size_t i = 0;
+        for(;i+8<=n;i+=8)
+        {
+            __m256 f = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(in + i), vLo), vScale), vHalf);
+            f = _mm256_min_ps(_mm256_max_ps(f, vZero), vMax);
+
+            const __m256i index = _mm256_cvttps_epi32(f);
+            const __m256i colors = _mm256_i32gather_epi32(reinterpret_cast<const int*>(table), index, 4);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), colors);
+        }
+
+        sampleScalar(table, maxIndex, in + i, out + i, n - i, lo, scale);
+    }
+#endif
+}
+
+GradientLut::GradientLut(const Resolution resolution) :
+    mTable(resolution)
+{
+    setGradient(QMap<float, QColor>());
+}
+
+GradientLut::GradientLut(const QMap<float, QColor>& stops, const Resolution resolution) :
+    mTable(resolution)
+{
+    setGradient(stops);
+}
+
+GradientLut GradientLut::fromString(const QString& config, const Resolution resolution)
+{
+    return GradientLut(WidgetGradientEditor::stringToGradient(config), resolution);
+}
+
+GradientLut GradientLut::fromPreset(const WidgetGradientEditor::Preset preset, const Resolution resolution)
+{
+    return GradientLut(WidgetGradientEditor::presetGradient(preset), resolution);
+}
+
+void GradientLut::setGradient(const QMap<float, QColor>& stops)
+{
+    fill(stops, 0, mTable.size() - 1);
+}
+
+void GradientLut::applyChanges(const GradientSnapshot& snapshot, const QVector<GradientChange>& changes)
+{
+    const QMap<float, QColor>& stops = snapshot.stops;
+    if(stops.isEmpty())
+    {
+        setGradient(stops);
+        return;
+    }
+
+    const int maxIndex = mTable.size() - 1;
+
+    for(int c=0;c<changes.size();c++)
+    {
+        const GradientChange& change = changes.at(c);
+        if(change.type == GradientChange::Reset)
+        {
+            setGradient(stops);
+            return;
+        }
+
+        // Only the entries between the stops enclosing a changed position can differ, for both
+        // the old and the new position (a stop moving across others changes both spans).
+        const float positions[2] = {change.oldPosition, change.newPosition};
+        for(int p=0;p<2;p++)
+        {
+            QMap<float, QColor>::const_iterator it = stops.lowerBound(positions[p]);
+            const float left = it == stops.constBegin() ? 0.0f : (it - 1).key();
+            it = stops.upperBound(positions[p]);
+            const float right = it == stops.constEnd() ? 1.0f : it.key();
+
+            const int first = qBound(0, (int)floorf(left * maxIndex), maxIndex);
+            const int last = qBound(0, (int)ceilf(right * maxIndex), maxIndex);
+            fill(stops, first, last);
+        }
+    }
+}
+
+void GradientLut::fill(const QMap<float, QColor>& stops, const int first, const int last)
+{
+    const QVector<Stop> s = validStops(stops);
+    const float step = 1.0f / (mTable.size() - 1);
+    uint32_t* table = mTable.data();
+
+    int next = 0; // first stop that is right of the current entry
+    for(int i=first;i<=last;i++)
+    {
+        const float t = i * step;
+        while(next < s.size() && s[next].position <= t) next++;
+
+        if(next == 0)
+        {
+            table[i] = pack(s[0].r, s[0].g, s[0].b, s[0].a);
+        }
+        else if(next == s.size())
+        {
+            const Stop& stop = s.last();
+            table[i] = pack(stop.r, stop.g, stop.b, stop.a);
+        }
+        else
+        {
+            const Stop& a = s[next - 1];
+            const Stop& b = s[next];
+            const float f = (t - a.position) / (b.position - a.position);
+            table[i] = pack(
+                        a.r + (b.r - a.r) * f,
+                        a.g + (b.g - a.g) * f,
+                        a.b + (b.b - a.b) * f,
+                        a.a + (b.a - a.a) * f);
+        }
+    }
+}
+
+uint32_t GradientLut::at(const float t) const
+{
+    const int maxIndex = mTable.size() - 1;
+    float f = t * maxIndex + 0.5f;
+    if(!(f > 0.0f)) f = 0.0f;
+    if(f > maxIndex) f = maxIndex;
+    return mTable[(int)f];
+}
+
+void GradientLut::sample(const float* in, uint32_t* out, const size_t n, const float lo, const float hi) const
+{
+    if(n == 0) return;
+
+    const int maxIndex = mTable.size() - 1;
+    const float scale = hi != lo ? maxIndex / (hi - lo) : 0.0f;
+
+#ifdef RANGESLIDERS_AVX2
+    if(simdHasAvx2())
+    {
+        sampleAvx2(mTable.constData(), maxIndex, in, out, n, lo, scale);
+        return;
+    }
+#endif
+
+#ifdef RANGESLIDERS_SSE2
+    sampleSse2(mTable.constData(), maxIndex, in, out, n, lo, scale);
+#else
+    sampleScalar(mTable.constData(), maxIndex, in, out, n, lo, scale);
+#endif
+}
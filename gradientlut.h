@@ -0,0 +1,58 @@
+#ifndef GRADIENTLUT_H
+#define GRADIENTLUT_H
+
+#include <QMap>
+#include <QColor>
+#include <QVector>
+#include <QString>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "widgetgradienteditor.h"
+
+// A fixed-resolution table of packed colors, sampled from a gradient map the same way a
+// QLinearGradient with PadSpread would paint it. Entries are QRgb (0xAARRGGBB), which is what
+// QImage::Format_ARGB32 uses, so sample() output can be written straight into a scanline.
+
+class GradientLut
+{
+public:
+    enum Resolution
+    {
+        Resolution256 = 256,
+        Resolution1024 = 1024,
+        Resolution4096 = 4096
+    };
+
+    explicit GradientLut(const Resolution resolution = Resolution1024);
+    GradientLut(const QMap<float, QColor>& stops, const Resolution resolution = Resolution1024);
+
+    static GradientLut fromString(const QString& config, const Resolution resolution = Resolution1024);
+    static GradientLut fromPreset(const WidgetGradientEditor::Preset preset, const Resolution resolution = Resolution1024);
+
+    void setGradient(const QMap<float, QColor>& stops);
+
+    // Brings the table up to date with snapshot, re-interpolating only the entries the given
+    // changes (see WidgetGradientEditor::gradientEdited()) can have affected.
+    void applyChanges(const GradientSnapshot& snapshot, const QVector<GradientChange>& changes);
+
+    int size() const { return mTable.size(); }
+    const uint32_t* data() const { return mTable.constData(); }
+
+    // color at relative position t, t is clamped to [0, 1]
+    uint32_t at(const float t) const;
+
+    // Maps every in[i] from [lo, hi] onto the table and writes its color to out[i]. Values at or
+    // below lo (and NaNs) get the first entry, values at or above hi get the last one. lo > hi
+    // flips the gradient, lo == hi maps everything to the first entry.
+    void sample(const float* in, uint32_t* out, const size_t n, const float lo, const float hi) const;
+
+private:
+    // re-interpolates entries [first, last] from the given stops
+    void fill(const QMap<float, QColor>& stops, const int first, const int last);
+
+    QVector<uint32_t> mTable;
+};
+
+#endif // GRADIENTLUT_H
@@ -0,0 +1,253 @@
+#include "gradientrasterizer.h"
+#include "simd.h"
+#include "widgetstats.h"
+
+#include <QCache>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+    // premultiplied, in the byte order of a little endian QRgb: b, g, r, a
+    struct Stop
+    {
+        float position;
+        float c[4];
+    };
+
+    QVector<Stop> validStops(const QMap<float, QColor>& stops)
+    {
+        QVector<Stop> result;
+        result.reserve(stops.size());
+
+        QMapIterator<float, QColor> i(stops);
+        while(i.hasNext())
+        {
+            i.next();
+            // QGradient::setColorAt() ignores these, so do we
+            if(i.key() < 0.0f || i.key() > 1.0f) continue;
+
+            const QColor& color = i.value();
+            const float alpha = color.alphaF();
+            const Stop stop = {i.key(), {color.blue() * alpha, color.green() * alpha, color.red() * alpha, (float)color.alpha()}};
+            result.append(stop);
+        }
+
+        // same default as QGradient: black to white
+        if(result.isEmpty())
+        {
+            const Stop black = {0.0f, {0.0f, 0.0f, 0.0f, 255.0f}};
+            const Stop white = {1.0f, {255.0f, 255.0f, 255.0f, 255.0f}};
+            result.append(black);
+            result.append(white);
+        }
+
+        return result;
+    }
+
+    // 4x4 Bayer matrix, offsets in (-0.5, 0.5) added before rounding
+    const float bayer[4][4] =
+    {
+        { 0,  8,  2, 10},
+        {12,  4, 14,  6},
+        { 3, 11,  1,  9},
+        {15,  7, 13,  5}
+    };
+
+    inline float ditherOffset(const int x, const int y)
+    {
+        return (bayer[y & 3][x & 3] + 0.5f) / 16.0f - 0.5f;
+    }
+
+    // pixels [first, last) of a row get base + delta * (x - first), plus the dither of row y
+    void fillSpanScalar(uint32_t* row, const int first, const int last, const float* base, const float* delta, const int y, const bool dither)
+    {
+        for(int x=first;x<last;x++)
+        {
+            const float offset = dither ? ditherOffset(x, y) : 0.0f;
+            uint32_t pixel = 0;
+            for(int k=0;k<4;k++)
+            {
+                const float v = base[k] + delta[k] * (x - first) + offset + 0.5f;
+                const int byte = v <= 0.0f ? 0 : v >= 255.0f ? 255 : (int)v;
+                pixel |= (uint32_t)byte << (8 * k);
+            }
+            row[x] = pixel;
+        }
+    }
+
+#ifdef RANGESLIDERS_SSE2
+    void fillSpanSse2(uint32_t* row, const int first, const int last, const float* base, const float* delta, const int y, const bool dither)
+    {
+        const __m128 vBase = _mm_loadu_ps(base);
+        const __m128 vDelta = _mm_loadu_ps(delta);
+        const __m128i zero = _mm_setzero_si128();
+
+        for(int x=first;x<last;x++)
+        {
+            __m128 v = _mm_add_ps(vBase, _mm_mul_ps(vDelta, _mm_set1_ps((float)(x - first))));
+            if(dither) v = _mm_add_ps(v, _mm_set1_ps(ditherOffset(x, y)));
+
+            // round, then saturate to bytes in two packs
+            const __m128i i32 = _mm_cvtps_epi32(v);
+            const __m128i i16 = _mm_packs_epi32(i32, zero);
+            row[x] = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(i16, zero));
+        }
+    }
+#endif
+
+    void fillSpan(uint32_t* row, const int first, const int last, const float* base, const float* delta, const int y, const bool dither)
+    {
+#ifdef RANGESLIDERS_SSE2
+        fillSpanSse2(row, first, last, base, delta, y, dither);
+#else
+        fillSpanScalar(row, first, last, base, delta, y, dither);
+#endif
+    }
+
+    // Pixel x shows the gradient at its center, t = (x + 0.5) / width, like QLinearGradient
+    // from 0 to width.
+    void renderRow(const QVector<Stop>& stops, uint32_t* row, const int width, const int y, const bool dither)
+    {
+        const float noDelta[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+        // first pixel whose center is at or right of position
+        const auto pixelAt = [width](const float position) { return qBound(0, (int)ceilf(position * width - 0.5f), width); };
+
+        int x = pixelAt(stops.first().position);
+        fillSpan(row, 0, x, stops.first().c, noDelta, y, dither);
+
+        for(int s=0;s+1<stops.size();s++)
+        {
+            const Stop& a = stops[s];
+            const Stop& b = stops[s + 1];
+            const int last = pixelAt(b.position);
+            if(last <= x) continue;
+
+            // colour at the first pixel's center, and its change per pixel
+            const float perPixel = 1.0f / ((b.position - a.position) * width);
+            const float f = ((x + 0.5f) / width - a.position) / (b.position - a.position);
+            float base[4], delta[4];
+            for(int k=0;k<4;k++)
+            {
+                base[k] = a.c[k] + (b.c[k] - a.c[k]) * f;
+                delta[k] = (b.c[k] - a.c[k]) * perPixel;
+            }
+
+            fillSpan(row, x, last, base, delta, y, dither);
+            x = last;
+        }
+
+        fillSpan(row, x, width, stops.last().c, noDelta, y, dither);
+    }
+
+    struct CacheKey
+    {
+        QByteArray stops;
+        QSize size;
+        qreal devicePixelRatio;
+        bool dither;
+
+        bool operator==(const CacheKey& o) const
+        {
+            return stops == o.stops && size == o.size && devicePixelRatio == o.devicePixelRatio && dither == o.dither;
+        }
+    };
+
+    uint qHash(const CacheKey& key, uint seed = 0)
+    {
+        return ::qHash(key.stops, seed) ^ ::qHash(key.size.width() * 65599 + key.size.height(), seed) ^ ::qHash((int)(key.devicePixelRatio * 1000), seed) ^ (key.dither ? 1 : 0);
+    }
+
+    // The stops, byte for byte: two gradients get the same key exactly when they look the same.
+    QByteArray stopsKey(const QMap<float, QColor>& stops)
+    {
+        QByteArray key;
+        key.reserve(stops.size() * 12);
+        QMapIterator<float, QColor> i(stops);
+        while(i.hasNext())
+        {
+            i.next();
+            const float position = i.key();
+            const QRgba64 color = i.value().rgba64();
+            key.append(reinterpret_cast<const char*>(&position), sizeof(position));
+            key.append(reinterpret_cast<const char*>(&color), sizeof(color));
+        }
+        return key;
+    }
+
+    QMutex cacheMutex;
+    QCache<CacheKey, QImage> cache(16 * 1024 * 1024);
+
+    // one address, so hits and misses end up in the same WidgetStats entry
+    const char* const statsSource = "GradientRasterizer";
+}
+
+QImage GradientRasterizer::rasterize(const QMap<float, QColor>& stops, const QSize& size, const bool dither)
+{
+    if(size.isEmpty()) return QImage();
+
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    const QVector<Stop> s = validStops(stops);
+
+    // rows only differ in their dither, so there are at most four different ones
+    const int distinctRows = dither ? qMin(4, size.height()) : 1;
+    for(int y=0;y<distinctRows;y++)
+        renderRow(s, reinterpret_cast<uint32_t*>(image.scanLine(y)), size.width(), y, dither);
+
+    for(int y=distinctRows;y<size.height();y++)
+        memcpy(image.scanLine(y), image.constScanLine(y % distinctRows), size.width() * sizeof(uint32_t));
+
+    return image;
+}
+
+QImage GradientRasterizer::image(const QMap<float, QColor>& stops, const QSize& size, const qreal devicePixelRatio, const bool dither)
+{
+    CacheKey key;
+    key.stops = stopsKey(stops);
+    key.size = size;
+    key.devicePixelRatio = devicePixelRatio;
+    key.dither = dither;
+
+    {
+        QMutexLocker locker(&cacheMutex);
+        if(const QImage* cached = cache.object(key))
+        {
+            WidgetStats::count(statsSource, WidgetStats::CacheHits);
+            return *cached;
+        }
+    }
+    WidgetStats::count(statsSource, WidgetStats::CacheMisses);
+
+    QImage image = rasterize(stops, size * devicePixelRatio, dither);
+    image.setDevicePixelRatio(devicePixelRatio);
+
+    QMutexLocker locker(&cacheMutex);
+    cache.insert(key, new QImage(image), qMax(1, image.byteCount()));
+    return image;
+}
+
+bool GradientRasterizer::saveImages(const QMap<float, QColor>& stops, const QString& fileNamePattern, const QList<int>& widths, const int height, const bool dither)
+{
+    for(int i=0;i<widths.size();i++)
+    {
+        const QImage image = rasterize(stops, QSize(widths[i], height), dither);
+        if(!image.save(fileNamePattern.arg(widths[i]))) return false;
+    }
+    return true;
+}
+
+void GradientRasterizer::setCacheLimit(const int bytes)
+{
+    QMutexLocker locker(&cacheMutex);
+    cache.setMaxCost(bytes);
+}
+
+void GradientRasterizer::clearCache()
+{
+    QMutexLocker locker(&cacheMutex);
+    cache.clear();
+}
@@ -0,0 +1,36 @@
+#ifndef GRADIENTRASTERIZER_H
+#define GRADIENTRASTERIZER_H
+
+#include <QMap>
+#include <QColor>
+#include <QImage>
+#include <QList>
+#include <QString>
+
+// Renders a gradient map straight into a QImage, left to right with PadSpread, without going
+// through QPainter and QLinearGradient. Every span between two stops is filled by stepping a
+// premultiplied colour (four floats in one SSE2 register), optionally with a 4x4 ordered dither
+// against banding. The result is Format_ARGB32_Premultiplied, so it blits without conversion.
+//
+// image() keeps the results in an LRU cache keyed on the stops, size, device pixel ratio and
+// dithering, so widgets showing the same gradient at the same size share one image, and legends,
+// thumbnails or exports can reuse it.
+class GradientRasterizer
+{
+public:
+    // uncached, size is in device pixels
+    static QImage rasterize(const QMap<float, QColor>& stops, const QSize& size, const bool dither = false);
+
+    // cached, size is in device independent pixels and the image carries the devicePixelRatio
+    static QImage image(const QMap<float, QColor>& stops, const QSize& size, const qreal devicePixelRatio = 1.0, const bool dither = false);
+
+    // Writes one image per width, fileNamePattern's %1 is replaced by the width. The format
+    // follows the file suffix, see QImage::save().
+    static bool saveImages(const QMap<float, QColor>& stops, const QString& fileNamePattern, const QList<int>& widths, const int height, const bool dither = true);
+
+    // in bytes, 16 MB by default
+    static void setCacheLimit(const int bytes);
+    static void clearCache();
+};
+
+#endif // GRADIENTRASTERIZER_H
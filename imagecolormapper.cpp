@@ -0,0 +1,197 @@
+#include "imagecolormapper.h"
+#include "simd.h"
+
+#include <QtConcurrent>
+
+namespace
+{
+    // out[i] = table[in[i]], for integer pixels whose table has a colour per possible value
+
+    template<typename T>
+    void lookupScalar(const uint32_t* table, const T* in, uint32_t* out, const int n)
+    {
+        for(int i=0;i<n;i++)
+            out[i] = table[in[i]];
+    }
+
+#ifdef RANGESLIDERS_AVX2
+    RANGESLIDERS_TARGET_AVX2 void lookupAvx2(const uint32_t* table, const quint8* in, uint32_t* out, const int n)
+    {
+        int i = 0;
+        for(;i+8<=n;i+=8)
+        {
+            const __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i)));
+            const __m256i colors = _mm256_i32gather_epi32(reinterpret_cast<const int*>(table), index, 4);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), colors);
+        }
+
+        lookupScalar(table, in + i, out + i, n - i);
+    }
+
+    RANGESLIDERS_TARGET_AVX2 void lookupAvx2(const uint32_t* table, const quint16* in, uint32_t* out, const int n)
+    {
+        int i = 0;
+        for(;i+8<=n;i+=8)
+        {
+            const __m256i index = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+            const __m256i colors = _mm256_i32gather_epi32(reinterpret_cast<const int*>(table), index, 4);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), colors);
+        }
+
+        lookupScalar(table, in + i, out + i, n - i);
+    }
+#endif
+
+    // there's no gather in SSE2, a scalar loop is as fast as anything else there
+    template<typename T>
+    void lookup(const uint32_t* table, const T* in, uint32_t* out, const int n)
+    {
+#ifdef RANGESLIDERS_AVX2
+        if(simdHasAvx2())
+        {
+            lookupAvx2(table, in, out, n);
+            return;
+        }
+#endif
+        lookupScalar(table, in, out, n);
+    }
+}
+
+ImageColorMapper::ImageColorMapper(const int tileSize) :
+    mTileSize(qMax(16, tileSize)),
+    mTilesX(0),
+    mTilesY(0),
+    mData(nullptr),
+    mFormat(Float32),
+    mWidth(0),
+    mHeight(0),
+    mStride(0),
+    mLo(0.0f),
+    mHi(1.0f),
+    mValueTableVersion(0),
+    mVersion(1)
+{
+}
+
+void ImageColorMapper::setSource(const void* data, const Format format, const int width, const int height, const int stride)
+{
+    mData = static_cast<const uchar*>(data);
+    mFormat = format;
+    mWidth = qMax(0, width);
+    mHeight = qMax(0, height);
+    mStride = stride;
+
+    if(mImage.width() != mWidth || mImage.height() != mHeight)
+        mImage = QImage(mWidth, mHeight, QImage::Format_ARGB32);
+
+    mTilesX = (mWidth + mTileSize - 1) / mTileSize;
+    mTilesY = (mHeight + mTileSize - 1) / mTileSize;
+    mTileVersions.fill(0, mTilesX * mTilesY);
+    invalidate();
+}
+
+void ImageColorMapper::setGradient(const QMap<float, QColor>& stops)
+{
+    mLut.setGradient(stops);
+    invalidate();
+}
+
+void ImageColorMapper::setGradient(const GradientLut& lut)
+{
+    mLut = lut;
+    invalidate();
+}
+
+void ImageColorMapper::applyGradientChanges(const GradientSnapshot& snapshot, const QVector<GradientChange>& changes)
+{
+    mLut.applyChanges(snapshot, changes);
+    invalidate();
+}
+
+void ImageColorMapper::setWindow(const float lo, const float hi)
+{
+    if(lo == mLo && hi == mHi) return;
+
+    mLo = lo;
+    mHi = hi;
+    invalidate();
+}
+
+void ImageColorMapper::updateValueTable()
+{
+    if(mFormat == Float32 || mValueTableVersion == mVersion) return;
+
+    // the table is the LUT sampled at every possible value, so it maps exactly like the float path
+    const int values = mFormat == UInt8 ? 256 : 65536;
+    QVector<float> ramp(values);
+    for(int v=0;v<values;v++)
+        ramp[v] = v;
+
+    mValueTable.resize(values);
+    mLut.sample(ramp.constData(), mValueTable.data(), values, mLo, mHi);
+    mValueTableVersion = mVersion;
+}
+
+QRect ImageColorMapper::render(const QRect& visible)
+{
+    if(!mData || mImage.isNull()) return QRect();
+
+    const QRect area = visible.isNull() ? mImage.rect() : (visible & mImage.rect());
+    if(area.isEmpty()) return QRect();
+
+    QVector<int> tiles;
+    QRect rendered;
+    for(int ty=area.top()/mTileSize;ty<=area.bottom()/mTileSize;ty++)
+    {
+        for(int tx=area.left()/mTileSize;tx<=area.right()/mTileSize;tx++)
+        {
+            const int tile = ty * mTilesX + tx;
+            if(mTileVersions[tile] == mVersion) continue;
+
+            tiles.append(tile);
+            mTileVersions[tile] = mVersion;
+            rendered |= QRect(tx * mTileSize, ty * mTileSize, mTileSize, mTileSize);
+        }
+    }
+
+    if(tiles.isEmpty()) return QRect();
+
+    updateValueTable();
+
+    // bits() detaches, so call it once here and not from the workers
+    uchar* bits = mImage.bits();
+    const int bytesPerLine = mImage.bytesPerLine();
+    QtConcurrent::blockingMap(tiles, [&](const int tile)
+    {
+        renderTile(tile, bits, bytesPerLine);
+    });
+
+    return rendered & mImage.rect();
+}
+
+void ImageColorMapper::renderTile(const int tile, uchar* bits, const int bytesPerLine) const
+{
+    const int x = (tile % mTilesX) * mTileSize;
+    const int y = (tile / mTilesX) * mTileSize;
+    const int width = qMin(mTileSize, mWidth - x);
+    const int height = qMin(mTileSize, mHeight - y);
+
+    for(int row=y;row<y+height;row++)
+    {
+        const uchar* in = mData + (qint64)row * mStride;
+        uint32_t* out = reinterpret_cast<uint32_t*>(bits + (qint64)row * bytesPerLine) + x;
+
+        switch(mFormat)
+        {
+        case UInt8:
+            lookup(mValueTable.constData(), reinterpret_cast<const quint8*>(in) + x, out, width);
+            break;
+        case UInt16:
+            lookup(mValueTable.constData(), reinterpret_cast<const quint16*>(in) + x, out, width);
+            break;
+        case Float32:
+            mLut.sample(reinterpret_cast<const float*>(in) + x, out, width, mLo, mHi);
+            break;
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef IMAGECOLORMAPPER_H
+#define IMAGECOLORMAPPER_H
+
+#include <QImage>
+#include <QVector>
+#include <QRect>
+
+#include "gradientlut.h"
+
+// False-colours a grayscale buffer (8 or 16 bit unsigned, or float, any stride) through a gradient
+// into a QImage::Format_ARGB32, typically with the window [lo, hi] of a FloatingGradientRangeSlider.
+//
+// The image is split into tiles that are rendered on all cores. Every tile remembers what it was
+// rendered for, so render() with the visible rect only touches visible tiles that are out of date;
+// the others catch up once they are scrolled into view. Changing the window doesn't touch the
+// GradientLut: float pixels are mapped through it directly (GradientLut::sample()), integer pixels
+// through a table with one colour per possible value, which is re-sampled from the LUT.
+class ImageColorMapper
+{
+public:
+    enum Format
+    {
+        UInt8,
+        UInt16,
+        Float32
+    };
+
+    explicit ImageColorMapper(const int tileSize = 256);
+
+    // The data must stay valid while render() may be called. stride is in bytes.
+    void setSource(const void* data, const Format format, const int width, const int height, const int stride);
+
+    void setGradient(const QMap<float, QColor>& stops);
+    void setGradient(const GradientLut& lut);
+    // see GradientLut::applyChanges()
+    void applyGradientChanges(const GradientSnapshot& snapshot, const QVector<GradientChange>& changes);
+
+    // values at or below lo get the first colour, at or above hi the last one
+    void setWindow(const float lo, const float hi);
+    float lo() const { return mLo; }
+    float hi() const { return mHi; }
+
+    // Brings the tiles intersecting visible (image coordinates, null means everything) up to date
+    // and returns the rect they cover, null if nothing had to be rendered.
+    QRect render(const QRect& visible = QRect());
+
+    const QImage& image() const { return mImage; }
+    const GradientLut& lut() const { return mLut; }
+    int tileSize() const { return mTileSize; }
+
+private:
+    void invalidate() { mVersion++; }
+    void updateValueTable();
+    void renderTile(const int tile, uchar* bits, const int bytesPerLine) const;
+
+    int mTileSize;
+    int mTilesX, mTilesY;
+
+    const uchar* mData;
+    Format mFormat;
+    int mWidth, mHeight, mStride;
+
+    GradientLut mLut;
+    float mLo, mHi;
+
+    // colour per value for integer formats, matches mValueTableVersion
+    QVector<uint32_t> mValueTable;
+    quint64 mValueTableVersion;
+
+    // a tile is current when its version equals mVersion
+    quint64 mVersion;
+    QVector<quint64> mTileVersions;
+
+    QImage mImage;
+};
+
+#endif // IMAGECOLORMAPPER_H
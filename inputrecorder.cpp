@@ -0,0 +1,132 @@
+#include "inputrecorder.h"
+
+#include <QWidget>
+#include <QFile>
+#include <QDataStream>
+#include <QMouseEvent>
+#include <QKeyEvent>
+
+namespace
+{
+    const quint32 magic = 0x52534952; // "RSIR"
+    const quint32 version = 1;
+}
+
+bool InputRecording::save(QIODevice* device) const
+{
+    QDataStream stream(device);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << magic << version << widgetSize << (quint32)events.size();
+    for(int i=0;i<events.size();i++)
+    {
+        const InputEvent& e = events[i];
+        stream << e.time << (qint32)e.type << e.pos << (qint32)e.button << (qint32)e.buttons << (qint32)e.modifiers
+               << (qint32)e.key << e.text << e.autoRepeat;
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+bool InputRecording::save(const QString& fileName) const
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    return save(&file);
+}
+
+bool InputRecording::load(QIODevice* device, InputRecording* recording)
+{
+    QDataStream stream(device);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 fileMagic = 0, fileVersion = 0, count = 0;
+    InputRecording r;
+    stream >> fileMagic >> fileVersion >> r.widgetSize >> count;
+    if(stream.status() != QDataStream::Ok || fileMagic != magic || fileVersion != version) return false;
+
+    // don't trust the count with the allocation, a truncated file runs out first
+    for(quint32 i=0;i<count && stream.status() == QDataStream::Ok;i++)
+    {
+        InputEvent e;
+        qint32 type, button, buttons, modifiers, key;
+        stream >> e.time >> type >> e.pos >> button >> buttons >> modifiers >> key >> e.text >> e.autoRepeat;
+        e.type = type;
+        e.button = button;
+        e.buttons = buttons;
+        e.modifiers = modifiers;
+        e.key = key;
+        r.events.append(e);
+    }
+    if(stream.status() != QDataStream::Ok) return false;
+
+    *recording = r;
+    return true;
+}
+
+bool InputRecording::load(const QString& fileName, InputRecording* recording)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly)) return false;
+    return load(&file, recording);
+}
+
+InputRecorder::InputRecorder(QObject* parent) :
+    QObject(parent)
+{
+}
+
+void InputRecorder::start(QWidget* widget)
+{
+    stop();
+
+    mRecording = InputRecording();
+    mRecording.widgetSize = widget->size();
+    mWidget = widget;
+    mWidget->installEventFilter(this);
+    mClock.start();
+}
+
+void InputRecorder::stop()
+{
+    if(mWidget) mWidget->removeEventFilter(this);
+    mWidget = nullptr;
+}
+
+bool InputRecorder::eventFilter(QObject* watched, QEvent* event)
+{
+    if(watched != mWidget) return false;
+
+    InputEvent e;
+    e.type = event->type();
+
+    switch(event->type())
+    {
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonRelease:
+    case QEvent::MouseButtonDblClick:
+    case QEvent::MouseMove:
+    {
+        const QMouseEvent* mouse = static_cast<const QMouseEvent*>(event);
+        e.pos = mouse->localPos();
+        e.button = mouse->button();
+        e.buttons = mouse->buttons();
+        e.modifiers = mouse->modifiers();
+        break;
+    }
+    case QEvent::KeyPress:
+    case QEvent::KeyRelease:
+    {
+        const QKeyEvent* key = static_cast<const QKeyEvent*>(event);
+        e.key = key->key();
+        e.modifiers = key->modifiers();
+        e.text = key->text();
+        e.autoRepeat = key->isAutoRepeat();
+        break;
+    }
+    default:
+        return false;
+    }
+
+    e.time = mClock.nsecsElapsed() / 1000;
+    mRecording.events.append(e);
+    return false;
+}
@@ -0,0 +1,69 @@
+#ifndef INPUTRECORDER_H
+#define INPUTRECORDER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+#include <QSize>
+#include <QPointF>
+#include <QString>
+#include <QElapsedTimer>
+
+class QWidget;
+class QIODevice;
+
+// One recorded mouse or key event. Positions are relative to the recorded widget.
+struct InputEvent
+{
+    InputEvent() : time(0), type(0), button(0), buttons(0), modifiers(0), key(0), autoRepeat(false) { }
+
+    qint64 time; // microseconds since the recording started
+    int type; // QEvent::Type
+    QPointF pos;
+    int button, buttons, modifiers;
+    int key;
+    QString text;
+    bool autoRepeat;
+};
+
+// A gesture, as captured by InputRecorder and played back by InputReplayer
+struct InputRecording
+{
+    QSize widgetSize; // for scaling positions to a widget of another size
+    QVector<InputEvent> events;
+
+    qint64 duration() const { return events.isEmpty() ? 0 : events.last().time; }
+
+    bool save(QIODevice* device) const;
+    bool save(const QString& fileName) const;
+    static bool load(QIODevice* device, InputRecording* recording);
+    static bool load(const QString& fileName, InputRecording* recording);
+};
+
+// Records the mouse and key events a widget receives, with timestamps, e.g. to replay a drag on
+// a RangeSlider or WidgetGradientEditor reproducibly. Works through an event filter, the widget
+// doesn't notice.
+class InputRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit InputRecorder(QObject* parent = nullptr);
+
+    void start(QWidget* widget); // discards what was recorded before
+    void stop();
+    bool isRecording() const { return mWidget; }
+
+    const InputRecording& recording() const { return mRecording; }
+    bool save(const QString& fileName) const { return mRecording.save(fileName); }
+
+protected:
+    bool eventFilter(QObject* watched, QEvent* event);
+
+private:
+    QPointer<QWidget> mWidget;
+    QElapsedTimer mClock;
+    InputRecording mRecording;
+};
+
+#endif // INPUTRECORDER_H
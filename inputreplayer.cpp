@@ -0,0 +1,166 @@
+#include "inputreplayer.h"
+
+#include <QWidget>
+#include <QApplication>
+#include <QEventLoop>
+#include <QTimer>
+#include <QMouseEvent>
+#include <QKeyEvent>
+#include <QMetaMethod>
+
+#include <math.h>
+
+#include <algorithm>
+
+qint64 InputReplayer::Report::percentile(QVector<qint64> latencies, const double p)
+{
+    if(latencies.isEmpty()) return -1;
+
+    // nearest rank
+    const int rank = qBound(0, (int)ceil(qBound(0.0, p, 100.0) / 100.0 * latencies.size()) - 1, latencies.size() - 1);
+    std::nth_element(latencies.begin(), latencies.begin() + rank, latencies.end());
+    return latencies[rank];
+}
+
+InputReplayer::InputReplayer(QObject* parent) :
+    QObject(parent),
+    mScaleToWidget(true),
+    mLastDelivered(-1)
+{
+    mWatchedSignals << "valueLoChanged" << "valueHiChanged" << "rangeChanged" << "rangeCommitted" << "gradientChanged";
+}
+
+InputReplayer::Report InputReplayer::replay(const InputRecording& recording, QWidget* widget, const Speed speed)
+{
+    mWidget = widget;
+    mReport = Report();
+    mUnpainted.clear();
+    mLastDelivered = -1;
+
+    if(!widget->isVisible())
+    {
+        widget->setAttribute(Qt::WA_DontShowOnScreen);
+        widget->show();
+    }
+
+    // connect to every watched signal the widget has, slotSignal() tells them apart
+    const QMetaObject* meta = widget->metaObject();
+    const int slotIndex = metaObject()->indexOfSlot("slotSignal()");
+    QVector<QMetaObject::Connection> connections;
+    for(int i=0;i<meta->methodCount();i++)
+    {
+        const QMetaMethod method = meta->method(i);
+        if(method.methodType() == QMetaMethod::Signal && mWatchedSignals.contains(method.name()))
+            connections.append(QMetaObject::connect(widget, i, this, slotIndex));
+    }
+    widget->installEventFilter(this);
+
+    // get the widget painted before the clock starts
+    QApplication::processEvents();
+
+    const qreal scaleX = mScaleToWidget && recording.widgetSize.width() > 0 ? (qreal)widget->width() / recording.widgetSize.width() : 1;
+    const qreal scaleY = mScaleToWidget && recording.widgetSize.height() > 0 ? (qreal)widget->height() / recording.widgetSize.height() : 1;
+
+    mClock.start();
+    for(int i=0;i<recording.events.size() && mWidget;i++)
+    {
+        const InputEvent& event = recording.events[i];
+
+        if(speed == OriginalSpeed)
+        {
+            // let the event loop run, that's where timers fire and paints happen
+            const qint64 wait = event.time - now();
+            if(wait > 0)
+            {
+                QEventLoop loop;
+                QTimer::singleShot((int)((wait + 999) / 1000), Qt::PreciseTimer, &loop, SLOT(quit()));
+                loop.exec();
+            }
+        }
+
+        deliver(event, scaleX, scaleY);
+
+        // Run the event loop unless the next event is due already. Events without a paint after
+        // that didn't cause one. When playback is behind, events pile up and share the next paint,
+        // like they would in a backed up event queue.
+        const bool behind = speed == OriginalSpeed && i + 1 < recording.events.size() && recording.events[i + 1].time <= now();
+        if(!behind)
+        {
+            QApplication::processEvents();
+            mReport.unpaintedEvents += mUnpainted.size();
+            mUnpainted.clear();
+        }
+    }
+
+    // whatever is still pending (coalesced commits, the last paint)
+    QApplication::processEvents();
+    mReport.duration = now();
+    mReport.unpaintedEvents += mUnpainted.size();
+    mUnpainted.clear();
+
+    for(int i=0;i<connections.size();i++)
+        disconnect(connections[i]);
+    if(mWidget) mWidget->removeEventFilter(this);
+    mWidget = nullptr;
+
+    return mReport;
+}
+
+void InputReplayer::deliver(const InputEvent& event, const qreal scaleX, const qreal scaleY)
+{
+    const QPointF pos(event.pos.x() * scaleX, event.pos.y() * scaleY);
+    const Qt::KeyboardModifiers modifiers(event.modifiers);
+
+    mLastDelivered = now();
+    mUnpainted.append(mLastDelivered);
+    mReport.events++;
+
+    switch(event.type)
+    {
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonRelease:
+    case QEvent::MouseButtonDblClick:
+    case QEvent::MouseMove:
+    {
+        QMouseEvent e((QEvent::Type)event.type, pos, mWidget->mapToGlobal(pos.toPoint()), (Qt::MouseButton)event.button, Qt::MouseButtons(event.buttons), modifiers);
+        QApplication::sendEvent(mWidget, &e);
+        break;
+    }
+    case QEvent::KeyPress:
+    case QEvent::KeyRelease:
+    {
+        QKeyEvent e((QEvent::Type)event.type, event.key, modifiers, event.text, event.autoRepeat);
+        QApplication::sendEvent(mWidget, &e);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void InputReplayer::slotSignal()
+{
+    if(mLastDelivered < 0 || sender() != mWidget) return;
+
+    const QByteArray name = sender()->metaObject()->method(senderSignalIndex()).name();
+    mReport.signalLatencies[name].append(now() - mLastDelivered);
+}
+
+bool InputReplayer::eventFilter(QObject* watched, QEvent* event)
+{
+    if(watched != mWidget || event->type() != QEvent::Paint) return false;
+
+    // Paint now instead of letting the event go on, that's the only way to know when it's done.
+    // QObject::event() is public, QWidget::event() isn't.
+    static_cast<QObject*>(mWidget)->event(event);
+    paintFinished();
+    return true;
+}
+
+void InputReplayer::paintFinished()
+{
+    const qint64 time = now();
+    for(int i=0;i<mUnpainted.size();i++)
+        mReport.paintLatencies.append(time - mUnpainted[i]);
+    mUnpainted.clear();
+}
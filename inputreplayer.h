@@ -0,0 +1,87 @@
+#ifndef INPUTREPLAYER_H
+#define INPUTREPLAYER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+#include <QMap>
+#include <QList>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+#include "inputrecorder.h"
+
+class QWidget;
+
+// Plays an InputRecording back against any widget, without a window system if need be (use the
+// offscreen platform), and measures how long the widget takes to react:
+//  - for every emission of a watched signal, the time since the event that was delivered last,
+//  - for every delivered event that led to a paint, the time until that paint has finished.
+// Paints are measured from the oldest event they cover, so coalesced repaints show up as the
+// latency the user actually sees. Events that didn't cause a paint by the time the event loop ran
+// (a press, a move that changes no value) are only counted, a later, unrelated paint isn't charged
+// to them.
+class InputReplayer : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Speed
+    {
+        OriginalSpeed, // wait for each event's timestamp, the event loop runs in between
+        MaximumSpeed // deliver the next event as soon as the previous one was handled and painted
+    };
+
+    struct Report
+    {
+        Report() : events(0), unpaintedEvents(0), duration(0) { }
+
+        // p in [0, 100], e.g. 50, 95 or 99. -1 if nothing was measured.
+        static qint64 percentile(QVector<qint64> latencies, const double p);
+        qint64 signalPercentile(const QByteArray& signal, const double p) const { return percentile(signalLatencies.value(signal), p); }
+        qint64 paintPercentile(const double p) const { return percentile(paintLatencies, p); }
+
+        int events;
+        int unpaintedEvents; // delivered but caused no paint, not in paintLatencies
+        qint64 duration; // microseconds for the whole replay
+        QMap<QByteArray, QVector<qint64> > signalLatencies; // microseconds, per signal name
+        QVector<qint64> paintLatencies; // microseconds
+    };
+
+    explicit InputReplayer(QObject* parent = nullptr);
+
+    // Signals to time, by name. Those the widget doesn't have are ignored. The default covers
+    // the sliders and the gradient editor.
+    void setWatchedSignals(const QList<QByteArray>& names) { mWatchedSignals = names; }
+    QList<QByteArray> watchedSignals() const { return mWatchedSignals; }
+
+    // Map positions from the recorded widget's size to the target's. On by default.
+    void setScaleToWidget(const bool scale) { mScaleToWidget = scale; }
+
+    // Blocks until the recording was played back. A widget that isn't visible is shown with
+    // Qt::WA_DontShowOnScreen, it can't be painted otherwise.
+    Report replay(const InputRecording& recording, QWidget* widget, const Speed speed = OriginalSpeed);
+
+protected:
+    bool eventFilter(QObject* watched, QEvent* event);
+
+private slots:
+    void slotSignal();
+
+private:
+    qint64 now() const { return mClock.nsecsElapsed() / 1000; }
+    void deliver(const InputEvent& event, const qreal scaleX, const qreal scaleY);
+    void paintFinished();
+
+    QList<QByteArray> mWatchedSignals;
+    bool mScaleToWidget;
+
+    // state during replay()
+    QPointer<QWidget> mWidget;
+    QElapsedTimer mClock;
+    Report mReport;
+    QVector<qint64> mUnpainted; // delivery times of events no paint has covered yet
+    qint64 mLastDelivered; // -1 before the first event
+};
+
+#endif // INPUTREPLAYER_H
@@ -0,0 +1,217 @@
+#include "multirangeslider.h"
+#include "rangecore.h"
+#include "widgetstats.h"
+
+#include <QMouseEvent>
+#include <QPainter>
+
+#include <algorithm>
+
+namespace
+{
+    typedef RangeValueTraits<int> IntTraits;
+}
+
+MultiRangeSlider::MultiRangeSlider(const int rangeMin, const int rangeMax, QWidget* parent) :
+    QWidget(parent),
+    mMinimum(qMin(rangeMin, rangeMax)),
+    mMaximum(qMax(rangeMin, rangeMax)),
+    mDragIndex(-1),
+    mDragOffset(0)
+{
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    setFocusPolicy(Qt::StrongFocus);
+
+    QStyleOptionSlider opt;
+    initStyleOption(&opt);
+    mSliderHandleSize = style()->subControlRect(QStyle::CC_Slider, &opt, QStyle::SC_SliderHandle, this).size();
+}
+
+void MultiRangeSlider::initStyleOption(QStyleOptionSlider* option) const
+{
+    option->initFrom(this);
+    option->subControls = QStyle::SC_None;
+    option->activeSubControls = QStyle::SC_None;
+    option->orientation = Qt::Horizontal;
+    option->state |= QStyle::State_Horizontal;
+    option->tickPosition = QSlider::NoTicks;
+    option->tickInterval = 0;
+    option->upsideDown = false;
+    option->direction = Qt::LeftToRight;
+
+    // handles are positioned in pixels, see paintEvent()
+    option->minimum = 0;
+    option->maximum = pixelSpan();
+}
+
+int MultiRangeSlider::pixelSpan() const
+{
+    return qMax(1, rect().width() - mSliderHandleSize.width());
+}
+
+int MultiRangeSlider::valueToPixel(const int value) const
+{
+    return IntTraits::toPixel(value, mMinimum, mMaximum, pixelSpan());
+}
+
+int MultiRangeSlider::pixelToValue(const int pixel) const
+{
+    return IntTraits::movedByPixels(mMinimum, pixel, mMinimum, mMaximum, pixelSpan());
+}
+
+QRect MultiRangeSlider::handleRect(const int value) const
+{
+    return QRect(QPoint(valueToPixel(value), 0), QSize(mSliderHandleSize.width(), height()));
+}
+
+int MultiRangeSlider::firstHandleRightOf(const int pixel) const
+{
+    // values are sorted and the mapping is monotonic, so the pixel positions are sorted, too
+    const int span = pixelSpan();
+    const int minimum = mMinimum, maximum = mMaximum;
+    const QVector<int>::const_iterator it = std::upper_bound(mValues.constBegin(), mValues.constEnd(), pixel, [=](const int p, const int value)
+    {
+        return p < IntTraits::toPixel(value, minimum, maximum, span);
+    });
+    return it - mValues.constBegin();
+}
+
+int MultiRangeSlider::handleAt(const QPoint& pos) const
+{
+    // the last handle starting left of pos is the topmost candidate, it's painted last
+    const int index = firstHandleRightOf(pos.x()) - 1;
+    if(index < 0) return -1;
+    return pos.x() < valueToPixel(mValues[index]) + mSliderHandleSize.width() ? index : -1;
+}
+
+void MultiRangeSlider::setRange(const int min, const int max)
+{
+    const int newMinimum = qMin(min, max);
+    const int newMaximum = qMax(min, max);
+    if(newMinimum == mMinimum && newMaximum == mMaximum) return;
+
+    mMinimum = newMinimum;
+    mMaximum = newMaximum;
+
+    // bounding keeps the order
+    for(int i=0;i<mValues.size();i++)
+        mValues[i] = qBound(mMinimum, mValues[i], mMaximum);
+
+    emit rangeChanged(mMinimum, mMaximum);
+    update();
+}
+
+void MultiRangeSlider::setValues(const QVector<int>& values)
+{
+    mValues = values;
+    for(int i=0;i<mValues.size();i++)
+        mValues[i] = qBound(mMinimum, mValues[i], mMaximum);
+    std::sort(mValues.begin(), mValues.end());
+
+    mDragIndex = -1;
+    emit valuesChanged();
+    update();
+}
+
+void MultiRangeSlider::setValue(const int index, const int value)
+{
+    if(index < 0 || index >= mValues.size()) return;
+
+    const int lowest = index > 0 ? mValues[index - 1] : mMinimum;
+    const int highest = index < mValues.size() - 1 ? mValues[index + 1] : mMaximum;
+    const int bounded = qBound(lowest, value, highest);
+    if(bounded == mValues[index]) return;
+
+    // the handle stays between its neighbours, so nothing outside its old and new position changes.
+    // The margin is for frames and antialiasing, like RangeSlider's.
+    const QRect dirty = (handleRect(mValues[index]) | handleRect(bounded)).adjusted(-2, 0, 2, 0);
+    mValues[index] = bounded;
+
+    emit valueChanged(index, bounded);
+    update(dirty);
+}
+
+int MultiRangeSlider::insertValue(const int value)
+{
+    const int bounded = qBound(mMinimum, value, mMaximum);
+    const int index = std::upper_bound(mValues.constBegin(), mValues.constEnd(), bounded) - mValues.constBegin();
+    mValues.insert(index, bounded);
+
+    emit valuesChanged();
+    update(handleRect(bounded).adjusted(-2, 0, 2, 0));
+    return index;
+}
+
+void MultiRangeSlider::removeValue(const int index)
+{
+    if(index < 0 || index >= mValues.size()) return;
+
+    const QRect dirty = handleRect(mValues[index]).adjusted(-2, 0, 2, 0);
+    mValues.remove(index);
+    if(mDragIndex == index) mDragIndex = -1;
+    else if(mDragIndex > index) mDragIndex--;
+
+    emit valuesChanged();
+    update(dirty);
+}
+
+void MultiRangeSlider::changeEvent(QEvent* e)
+{
+    if(e->type() == QEvent::StyleChange)
+    {
+        QStyleOptionSlider opt;
+        initStyleOption(&opt);
+        mSliderHandleSize = style()->subControlRect(QStyle::CC_Slider, &opt, QStyle::SC_SliderHandle, this).size();
+        update();
+    }
+    QWidget::changeEvent(e);
+}
+
+void MultiRangeSlider::mousePressEvent(QMouseEvent* e)
+{
+    mDragIndex = handleAt(e->pos());
+    if(mDragIndex == -1) return;
+
+    mDragOffset = e->pos().x() - valueToPixel(mValues[mDragIndex]);
+}
+
+void MultiRangeSlider::mouseMoveEvent(QMouseEvent* e)
+{
+    if(!e->buttons() || mDragIndex == -1) return;
+
+    setValue(mDragIndex, pixelToValue(e->pos().x() - mDragOffset));
+}
+
+void MultiRangeSlider::mouseReleaseEvent(QMouseEvent*)
+{
+    mDragIndex = -1;
+}
+
+void MultiRangeSlider::paintEvent(QPaintEvent* e)
+{
+    WidgetStats::Scope scope(this, "paint", WidgetStats::Scope::Paint);
+
+    QPainter p(this);
+    p.setRenderHint(QPainter::Antialiasing, true);
+
+    QStyleOptionSlider opt;
+    initStyleOption(&opt);
+
+    // draw whole-length groove, the painter clips it to the exposed region
+    opt.subControls = QStyle::SC_SliderGroove;
+    style()->drawComplexControl(QStyle::CC_Slider, &opt, &p, this);
+
+    // Only draw handles that reach into the exposed rect
+    const QRect exposed = e->rect();
+    const int first = firstHandleRightOf(exposed.left() - mSliderHandleSize.width());
+    const int last = firstHandleRightOf(exposed.right());
+
+    opt.subControls = QStyle::SC_SliderHandle;
+    for(int i=first;i<last;i++)
+    {
+        const int pixel = valueToPixel(mValues[i]);
+        opt.sliderPosition = pixel;
+        opt.sliderValue = pixel;
+        style()->drawComplexControl(QStyle::CC_Slider, &opt, &p, this);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef MULTIRANGESLIDER_H
+#define MULTIRANGESLIDER_H
+
+#include <QWidget>
+#include <QVector>
+#include <QStyleOption>
+
+// A slider with any number of handles, e.g. for the cut points of classification bins. The values
+// are kept sorted in one contiguous array and a handle can't pass its neighbours, so hit testing
+// and paint culling are binary searches and dragging repaints only the handle's surroundings.
+//
+// Warning: like RangeSlider, only works for horizontal sliders.
+class MultiRangeSlider : public QWidget
+{
+    Q_OBJECT
+
+public:
+    MultiRangeSlider(const int rangeMin, const int rangeMax, QWidget* parent = nullptr);
+
+    int minimum() const { return mMinimum; }
+    int maximum() const { return mMaximum; }
+    int count() const { return mValues.size(); }
+    int value(const int index) const { return mValues.at(index); }
+    const QVector<int>& values() const { return mValues; }
+
+    // index of the handle at pos, or -1. When handles overlap, the topmost one wins.
+    int handleAt(const QPoint& pos) const;
+
+    QSize sizeHint() const { return QSize(150, 20); }
+    QSize minimumSizeHint() const { return QSize(30, 20); }
+
+public slots:
+    void setRange(const int min, const int max);
+    void setValues(const QVector<int>& values); // need not be sorted
+    void setValue(const int index, const int value); // bounded by the neighbours
+    int insertValue(const int value); // returns the new handle's index
+    void removeValue(const int index);
+
+signals:
+    void valueChanged(int index, int value);
+    void valuesChanged(); // handles were added, removed or replaced
+    void rangeChanged(int min, int max);
+
+protected:
+    void initStyleOption(QStyleOptionSlider* option) const;
+    int pixelSpan() const;
+    int valueToPixel(const int value) const;
+    int pixelToValue(const int pixel) const;
+    QRect handleRect(const int value) const;
+
+    // first handle whose left edge is right of pixel
+    int firstHandleRightOf(const int pixel) const;
+
+    void changeEvent(QEvent*);
+    void mousePressEvent(QMouseEvent*);
+    void mouseMoveEvent(QMouseEvent*);
+    void mouseReleaseEvent(QMouseEvent*);
+    void paintEvent(QPaintEvent*);
+
+    QSize mSliderHandleSize;
+    int mMinimum, mMaximum;
+    QVector<int> mValues; // sorted
+    int mDragIndex; // -1 when not dragging
+    int mDragOffset; // pixels between the cursor and the dragged handle's left edge
+};
+
+#endif // MULTIRANGESLIDER_H
@@ -0,0 +1,77 @@
+#ifndef PARALLELSORT_H
+#define PARALLELSORT_H
+
+#include <QVector>
+#include <QThread>
+#include <QAtomicInt>
+#include <QtConcurrent>
+
+#include <algorithm>
+
+// Sorts v on the global thread pool: std::sort on one chunk per thread, then rounds of pairwise
+// std::merge (also in parallel) through a buffer of the same size. Small vectors are sorted inline.
+//
+// A set cancel flag is noticed between chunks and between merge rounds. v is left in no particular
+// order then.
+template<typename T, typename Less>
+void parallelSort(QVector<T>& v, Less less, const QAtomicInt* cancel = nullptr)
+{
+    const int n = v.size();
+    const int threads = QThread::idealThreadCount();
+    if(n < (1 << 16) || threads < 2)
+    {
+        std::sort(v.begin(), v.end(), less);
+        return;
+    }
+
+    // segment s is [bounds[s], bounds[s + 1])
+    QVector<int> bounds;
+    for(int c=0;c<=threads;c++)
+        bounds.append((qint64)n * c / threads);
+
+    QVector<int> segments;
+    for(int s=0;s<threads;s++)
+        segments.append(s);
+
+    T* data = v.data();
+    QtConcurrent::blockingMap(segments, [&](const int s)
+    {
+        if(cancel && cancel->load()) return;
+        std::sort(data + bounds[s], data + bounds[s + 1], less);
+    });
+    if(cancel && cancel->load()) return;
+
+    QVector<T> buffer(n);
+    T* from = data;
+    T* to = buffer.data();
+    while(bounds.size() > 2)
+    {
+        if(cancel && cancel->load()) return;
+
+        // merge segments 2k and 2k+1, an odd one out is copied
+        QVector<int> pairs;
+        QVector<int> merged;
+        for(int s=0;s+1<bounds.size();s+=2)
+        {
+            pairs.append(s);
+            merged.append(bounds[s]);
+        }
+        merged.append(n);
+
+        QtConcurrent::blockingMap(pairs, [&](const int s)
+        {
+            if(cancel && cancel->load()) return;
+            if(s + 2 < bounds.size())
+                std::merge(from + bounds[s], from + bounds[s + 1], from + bounds[s + 1], from + bounds[s + 2], to + bounds[s], less);
+            else
+                std::copy(from + bounds[s], from + bounds[s + 1], to + bounds[s]);
+        });
+
+        bounds = merged;
+        std::swap(from, to);
+    }
+
+    if(from != data) v.swap(buffer);
+}
+
+#endif // PARALLELSORT_H
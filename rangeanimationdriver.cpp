@@ -0,0 +1,66 @@
+#include "rangeanimationdriver.h"
+#include "rangeslider.h"
+#include "widgetstats.h"
+
+#include <QCoreApplication>
+#include <QGuiApplication>
+#include <QPointer>
+#include <QScreen>
+#include <QTimer>
+
+RangeAnimationDriver* RangeAnimationDriver::instance()
+{
+    // owned by the application, so a later application (test runners, the benchmark) gets a new one
+    static QPointer<RangeAnimationDriver> driver;
+    if(!driver) driver = new RangeAnimationDriver;
+    return driver;
+}
+
+RangeAnimationDriver::RangeAnimationDriver() :
+    QObject(QCoreApplication::instance())
+{
+    mTimer = new QTimer(this);
+    mTimer->setTimerType(Qt::PreciseTimer);
+    connect(mTimer, &QTimer::timeout, this, &RangeAnimationDriver::slotFrame);
+    mClock.start();
+}
+
+int RangeAnimationDriver::frameInterval() const
+{
+    const QScreen* screen = QGuiApplication::primaryScreen();
+    const qreal refreshRate = screen ? screen->refreshRate() : 0;
+    return refreshRate > 0 ? qMax(1, qRound(1000 / refreshRate)) : 16;
+}
+
+void RangeAnimationDriver::add(FloatingRangeSlider* slider)
+{
+    if(mSliders.contains(slider)) return;
+    mSliders.append(slider);
+
+    if(!mTimer->isActive())
+    {
+        mTimer->setInterval(frameInterval());
+        mTimer->start();
+    }
+}
+
+void RangeAnimationDriver::remove(FloatingRangeSlider* slider)
+{
+    mSliders.removeOne(slider);
+    if(mSliders.isEmpty()) mTimer->stop();
+}
+
+void RangeAnimationDriver::slotFrame()
+{
+    // Everybody gets the same timestamp, so sliders started together stay in step. Settling emits
+    // rangeChanged(), and a listener might start, stop or delete sliders - walk a copy.
+    WidgetStats::Scope scope(this, "frame");
+
+    const qint64 time = now();
+    const QVector<FloatingRangeSlider*> sliders = mSliders;
+    for(int i=0;i<sliders.size();i++)
+    {
+        if(mSliders.contains(sliders[i]))
+            sliders[i]->stepAnimation(time);
+    }
+}
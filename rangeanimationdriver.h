@@ -0,0 +1,40 @@
+#ifndef RANGEANIMATIONDRIVER_H
+#define RANGEANIMATIONDRIVER_H
+
+#include <QObject>
+#include <QVector>
+#include <QElapsedTimer>
+
+class QTimer;
+class FloatingRangeSlider;
+
+// One frame clock for all FloatingRangeSliders that are rescaling. Instead of a timer (or two
+// QPropertyAnimations) per slider, every animating slider is stepped once per frame in a single
+// batch, and the timer only runs while something animates. The frame interval follows the primary
+// screen's refresh rate.
+class RangeAnimationDriver : public QObject
+{
+    Q_OBJECT
+
+public:
+    static RangeAnimationDriver* instance();
+
+    void add(FloatingRangeSlider* slider);
+    void remove(FloatingRangeSlider* slider);
+
+    int activeCount() const { return mSliders.size(); }
+    qint64 now() const { return mClock.elapsed(); } // msecs
+    int frameInterval() const; // msecs
+
+private slots:
+    void slotFrame();
+
+private:
+    RangeAnimationDriver();
+
+    QTimer* mTimer;
+    QElapsedTimer mClock;
+    QVector<FloatingRangeSlider*> mSliders;
+};
+
+#endif // RANGEANIMATIONDRIVER_H
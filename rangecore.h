@@ -0,0 +1,85 @@
+#ifndef RANGECORE_H
+#define RANGECORE_H
+
+#include <QtGlobal>
+
+// The mapping between a range slider's values and pixels, specialized per value type in
+// RangeValueTraits. Integers are mapped with integer math only and never round-trip through float.
+
+// x * numerator / denominator for x in [0, denominator], as a multiplication and a shift. The
+// factor is rounded up and gets as many fraction bits as the product allows, which keeps both ends
+// exact and everything in between exact for all but huge ranges. RangeValueTraits<int> maps with it
+// and RangeSlider caches one per direction, so every int slider puts a value on the same pixel.
+struct RangeScale
+{
+    RangeScale() : factor(0), shift(0), limit(0), denominator(0) { }
+    RangeScale(const quint64 numerator, const quint64 denominator) { set(numerator, denominator); }
+
+    void set(const quint64 n, const quint64 d)
+    {
+        limit = (qint64)n;
+        denominator = d;
+        factor = 0;
+        shift = 0;
+        if(d == 0) return;
+
+        // (n << shift) must stay below 2^63, then the product of x <= d and the factor does, too
+        int bits = 0;
+        while(bits < 63 && (n >> bits)) bits++;
+        shift = qMin(63 - bits, 62);
+        factor = ((n << shift) + d - 1) / d;
+    }
+
+    qint64 scaled(const qint64 x) const
+    {
+        if(x <= 0) return 0;
+        if((quint64)x >= denominator) return limit;
+        return (qint64)(((quint64)x * factor) >> shift);
+    }
+
+    quint64 factor;
+    int shift;
+    qint64 limit;
+    quint64 denominator;
+};
+
+// Every specialization provides
+//  - toPixel(value, minimum, maximum, pixels): offset of value in [0, pixels]
+//  - movedByPixels(value, pixelDelta, minimum, maximum, pixels): value moved by pixelDelta pixels,
+//    bounded to [minimum, maximum]
+template<typename T>
+struct RangeValueTraits;
+
+template<>
+struct RangeValueTraits<int>
+{
+    static int toPixel(const int value, const int minimum, const int maximum, const int pixels)
+    {
+        if(maximum <= minimum || pixels <= 0) return 0;
+        return toPixel(value, minimum, RangeScale(pixels, (quint64)((qint64)maximum - minimum)));
+    }
+
+    static int movedByPixels(const int value, const int pixelDelta, const int minimum, const int maximum, const int pixels)
+    {
+        if(pixels <= 0) return value;
+        return movedByPixels(value, pixelDelta, minimum, maximum, pixels, RangeScale((quint64)((qint64)maximum - minimum), pixels));
+    }
+
+    // The same with the scale precomputed, for callers that cache it: pixelScale maps
+    // maximum - minimum to pixels, valueScale pixels to maximum - minimum.
+    static int toPixel(const int value, const int minimum, const RangeScale& pixelScale)
+    {
+        return (int)pixelScale.scaled((qint64)value - minimum);
+    }
+
+    static int movedByPixels(const int value, const int pixelDelta, const int minimum, const int maximum, const int pixels, const RangeScale& valueScale)
+    {
+        if(pixels <= 0) return value;
+        // moving further than the whole span ends at a bound anyway
+        const quint64 steps = qMin((quint64)qAbs((qint64)pixelDelta), (quint64)pixels);
+        const qint64 distance = valueScale.scaled(steps);
+        return (int)qBound((qint64)minimum, pixelDelta > 0 ? value + distance : value - distance, (qint64)maximum);
+    }
+};
+
+#endif // RANGECORE_H
@@ -0,0 +1,248 @@
+#include "rangecounter.h"
+#include "rangeslider.h"
+#include "parallelsort.h"
+
+#include <QTimer>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+namespace
+{
+    // values per job
+    const int chunkSize = 1 << 20;
+
+    // about as many bytes as fit into a QVector
+    const qint64 byteLimit = std::numeric_limits<int>::max() - 64;
+
+    struct Chunk
+    {
+        int first, count;
+        double sum;
+    };
+
+    void store(RangeCounter::Index& index, const QVector<float>& sorted) { index.type = RangeCounter::Index::Float; index.floats = sorted; }
+    void store(RangeCounter::Index& index, const QVector<double>& sorted) { index.type = RangeCounter::Index::Double; index.doubles = sorted; }
+    void store(RangeCounter::Index& index, const QVector<int>& sorted) { index.type = RangeCounter::Index::Int; index.ints = sorted; }
+
+    // [first, last) of sorted is in [lo, hi], compared as doubles, which holds floats and ints exactly
+    template<typename T>
+    void locateIn(const QVector<T>& sorted, const double lo, const double hi, int& first, int& last)
+    {
+        const typename QVector<T>::const_iterator begin = sorted.constBegin();
+        const typename QVector<T>::const_iterator end = sorted.constEnd();
+        first = std::lower_bound(begin, end, lo, [](const T value, const double bound) { return value < bound; }) - begin;
+        last = std::upper_bound(begin + first, end, hi, [](const double bound, const T value) { return bound < value; }) - begin;
+    }
+
+    template<typename T>
+    RangeCounter::Index computeIndex(const T* values, const qint64 count, const bool sums, const quint64 generation, QSharedPointer<QAtomicInt> cancel)
+    {
+        RangeCounter::Index index;
+        index.generation = generation;
+        // the prefix sums are doubles, the sorted values as large as T
+        const qint64 rowLimit = byteLimit / (qint64)(sums ? sizeof(double) : sizeof(T));
+        if(count > rowLimit)
+        {
+            qWarning("RangeCounter: %lld values are too many, at most %lld are supported", count, rowLimit);
+            return index;
+        }
+
+        QVector<T> sorted;
+        sorted.reserve(count);
+        for(qint64 first=0;first<count;first+=chunkSize)
+        {
+            if(cancel->load()) return index;
+
+            const qint64 last = qMin(first + chunkSize, count);
+            for(qint64 i=first;i<last;i++)
+            {
+                const T x = values[i];
+                if(x == x) sorted.append(x);
+            }
+        }
+
+        parallelSort(sorted, std::less<T>(), cancel.data());
+        if(cancel->load()) return index;
+
+        if(sums)
+        {
+            const int n = sorted.size();
+            QVector<double> prefixSums(n + 1);
+            prefixSums[0] = 0.0;
+
+            QVector<Chunk> chunks;
+            for(int first=0;first<n;first+=chunkSize)
+            {
+                Chunk chunk;
+                chunk.first = first;
+                chunk.count = qMin(chunkSize, n - first);
+                chunk.sum = 0.0;
+                chunks.append(chunk);
+            }
+
+            // chunk totals first, then every chunk fills its part of the prefix sums from its offset
+            const T* v = sorted.constData();
+            double* p = prefixSums.data();
+            QtConcurrent::blockingMap(chunks, [&](Chunk& chunk)
+            {
+                if(cancel->load()) return;
+                for(int i=0;i<chunk.count;i++)
+                    chunk.sum += v[chunk.first + i];
+            });
+            if(cancel->load()) return index;
+
+            double offset = 0.0;
+            for(int c=0;c<chunks.size();c++)
+            {
+                const double sum = chunks[c].sum;
+                chunks[c].sum = offset;
+                offset += sum;
+            }
+
+            QtConcurrent::blockingMap(chunks, [&](Chunk& chunk)
+            {
+                double sum = chunk.sum;
+                for(int i=0;i<chunk.count;i++)
+                {
+                    sum += v[chunk.first + i];
+                    p[chunk.first + i + 1] = sum;
+                }
+            });
+
+            index.prefixSums = prefixSums;
+        }
+
+        store(index, sorted);
+        return index;
+    }
+}
+
+RangeCounter::RangeCounter(QObject* parent, const bool sums) :
+    QObject(parent),
+    mSums(sums),
+    mLo(0.0),
+    mHi(0.0),
+    mCount(0),
+    mSum(0.0),
+    mNotifiedCount(0),
+    mNotifiedSum(0.0),
+    mJob(this)
+{
+    mJob.onFinished(this, &RangeCounter::slotFinished);
+
+    mNotifyTimer = new QTimer(this);
+    mNotifyTimer->setSingleShot(true);
+    mNotifyTimer->setInterval(0);
+    connect(mNotifyTimer, &QTimer::timeout, this, &RangeCounter::slotNotify);
+}
+
+void RangeCounter::setData(const float* values, const qint64 count)
+{
+    start(values, count);
+}
+
+void RangeCounter::setData(const double* values, const qint64 count)
+{
+    start(values, count);
+}
+
+void RangeCounter::setData(const int* values, const qint64 count)
+{
+    start(values, count);
+}
+
+template<typename T>
+void RangeCounter::start(const T* values, const qint64 count)
+{
+    mJob.cancel();
+    mJob.setFuture(QtConcurrent::run(&computeIndex<T>, values, count, mSums, mJob.generation(), mJob.cancelFlag()));
+}
+
+void RangeCounter::clear()
+{
+    mJob.cancel();
+    mIndex = Index();
+    recount();
+}
+
+void RangeCounter::attach(RangeSlider* slider)
+{
+    // the values, not rangeCommitted(): the getters stay current during a drag, countChanged() is
+    // coalesced anyway
+    connect(slider, &RangeSlider::valueLoChanged, this, [this, slider]() { setRange(slider->valueLo(), slider->valueHi()); });
+    connect(slider, &RangeSlider::valueHiChanged, this, [this, slider]() { setRange(slider->valueLo(), slider->valueHi()); });
+    setRange(slider->valueLo(), slider->valueHi());
+}
+
+void RangeCounter::setRange(const double lo, const double hi)
+{
+    if(lo == mLo && hi == mHi) return;
+
+    mLo = lo;
+    mHi = hi;
+    recount();
+}
+
+void RangeCounter::slotFinished()
+{
+    const Index index = mJob.result();
+    if(index.generation != mJob.generation()) return;
+
+    mIndex = index;
+    recount();
+    emit ready();
+}
+
+void RangeCounter::locate(const double lo, const double hi, int& first, int& last) const
+{
+    if(!(lo <= hi))
+    {
+        first = last = 0;
+        return;
+    }
+
+    switch(mIndex.type)
+    {
+    case Index::Float: locateIn(mIndex.floats, lo, hi, first, last); break;
+    case Index::Double: locateIn(mIndex.doubles, lo, hi, first, last); break;
+    case Index::Int: locateIn(mIndex.ints, lo, hi, first, last); break;
+    }
+}
+
+qint64 RangeCounter::countIn(const double lo, const double hi) const
+{
+    int first, last;
+    locate(lo, hi, first, last);
+    return last - first;
+}
+
+double RangeCounter::sumIn(const double lo, const double hi) const
+{
+    if(mIndex.prefixSums.isEmpty()) return 0.0;
+
+    int first, last;
+    locate(lo, hi, first, last);
+    return mIndex.prefixSums[last] - mIndex.prefixSums[first];
+}
+
+void RangeCounter::recount()
+{
+    int first, last;
+    locate(mLo, mHi, first, last);
+    mCount = last - first;
+    mSum = mIndex.prefixSums.isEmpty() ? 0.0 : mIndex.prefixSums[last] - mIndex.prefixSums[first];
+
+    if(!mNotifyTimer->isActive()) mNotifyTimer->start();
+}
+
+void RangeCounter::slotNotify()
+{
+    if(mCount == mNotifiedCount && mSum == mNotifiedSum) return;
+
+    mNotifiedCount = mCount;
+    mNotifiedSum = mSum;
+    emit countChanged(mCount);
+}
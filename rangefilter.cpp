@@ -0,0 +1,466 @@
+#include "rangefilter.h"
+#include "rangeslider.h"
+#include "parallelsort.h"
+#include "simd.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+namespace
+{
+    // rows per job, a multiple of 64 so every job writes its own words
+    const qint64 chunkSize = 1 << 20;
+
+    // more rows than this don't get an index (the permutation is a QVector<quint32>)
+    const qint64 indexRowLimit = 1 << 28;
+
+    struct Chunk
+    {
+        qint64 first, count;
+        qint64 selected;
+    };
+
+    // The column's bounds for [lo, hi], such that lo' <= x <= hi' holds exactly for the values x
+    // with lo <= x <= hi. Returns false when no value can be in range.
+    template<typename T>
+    bool columnBounds(const double lo, const double hi, T& columnLo, T& columnHi)
+    {
+        if(!(lo <= hi)) return false;
+
+        const double l = ceil(lo);
+        const double h = floor(hi);
+        const double minimum = (double)std::numeric_limits<T>::min();
+        const double maximum = (double)std::numeric_limits<T>::max();
+        if(l > h || l > maximum || h < minimum) return false;
+
+        columnLo = l <= minimum ? std::numeric_limits<T>::min() : l >= maximum ? std::numeric_limits<T>::max() : (T)l;
+        columnHi = h >= maximum ? std::numeric_limits<T>::max() : h <= minimum ? std::numeric_limits<T>::min() : (T)h;
+        return true;
+    }
+
+    template<>
+    bool columnBounds<float>(const double lo, const double hi, float& columnLo, float& columnHi)
+    {
+        if(!(lo <= hi)) return false;
+
+        // round inwards, so comparing in float gives the same answer as comparing in double
+        columnLo = (float)lo;
+        if((double)columnLo < lo) columnLo = nextafterf(columnLo, std::numeric_limits<float>::infinity());
+        columnHi = (float)hi;
+        if((double)columnHi > hi) columnHi = nextafterf(columnHi, -std::numeric_limits<float>::infinity());
+        return columnLo <= columnHi;
+    }
+
+    template<>
+    bool columnBounds<double>(const double lo, const double hi, double& columnLo, double& columnHi)
+    {
+        columnLo = lo;
+        columnHi = hi;
+        return lo <= hi;
+    }
+
+    // All kernels write one word per 64 rows (the last one possibly partial) and return the number
+    // of selected rows. NaN fails both comparisons, so it is never selected.
+
+    template<typename T>
+    quint64 wordScalar(const T* v, const int n, const T lo, const T hi)
+    {
+        quint64 word = 0;
+        for(int b=0;b<n;b++)
+            if(v[b] >= lo && v[b] <= hi) word |= Q_UINT64_C(1) << b;
+        return word;
+    }
+
+    template<typename T>
+    qint64 scanScalar(const T* v, const qint64 count, const T lo, const T hi, quint64* words)
+    {
+        qint64 selected = 0;
+        for(qint64 i=0;i<count;i+=64)
+        {
+            const quint64 word = wordScalar(v + i, (int)qMin((qint64)64, count - i), lo, hi);
+            words[i >> 6] = word;
+            selected += qPopulationCount(word);
+        }
+        return selected;
+    }
+
+#ifdef RANGESLIDERS_SSE2
+    inline quint64 wordSse2(const float* v, const float lo, const float hi)
+    {
+        const __m128 vLo = _mm_set1_ps(lo);
+        const __m128 vHi = _mm_set1_ps(hi);
+        quint64 word = 0;
+        for(int b=0;b<64;b+=4)
+        {
+            const __m128 x = _mm_loadu_ps(v + b);
+            const __m128 in = _mm_and_ps(_mm_cmpge_ps(x, vLo), _mm_cmple_ps(x, vHi));
+            word |= (quint64)_mm_movemask_ps(in) << b;
+        }
+        return word;
+    }
+
+    inline quint64 wordSse2(const double* v, const double lo, const double hi)
+    {
+        const __m128d vLo = _mm_set1_pd(lo);
+        const __m128d vHi = _mm_set1_pd(hi);
+        quint64 word = 0;
+        for(int b=0;b<64;b+=2)
+        {
+            const __m128d x = _mm_loadu_pd(v + b);
+            const __m128d in = _mm_and_pd(_mm_cmpge_pd(x, vLo), _mm_cmple_pd(x, vHi));
+            word |= (quint64)_mm_movemask_pd(in) << b;
+        }
+        return word;
+    }
+
+    inline quint64 wordSse2(const int* v, const int lo, const int hi)
+    {
+        const __m128i vLo = _mm_set1_epi32(lo);
+        const __m128i vHi = _mm_set1_epi32(hi);
+        quint64 word = 0;
+        for(int b=0;b<64;b+=4)
+        {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + b));
+            const __m128i out = _mm_or_si128(_mm_cmplt_epi32(x, vLo), _mm_cmpgt_epi32(x, vHi));
+            word |= (quint64)(~_mm_movemask_ps(_mm_castsi128_ps(out)) & 0xF) << b;
+        }
+        return word;
+    }
+
+    // SSE2 can't compare 64 bit integers
+    inline quint64 wordSse2(const qint64* v, const qint64 lo, const qint64 hi)
+    {
+        return wordScalar(v, 64, lo, hi);
+    }
+
+    template<typename T>
+    qint64 scanSse2(const T* v, const qint64 count, const T lo, const T hi, quint64* words)
+    {
+        qint64 selected = 0;
+        qint64 i = 0;
+        for(;i+64<=count;i+=64)
+        {
+            const quint64 word = wordSse2(v + i, lo, hi);
+            words[i >> 6] = word;
+            selected += qPopulationCount(word);
+        }
+
+        return selected + scanScalar(v + i, count - i, lo, hi, words + (i >> 6));
+    }
+#endif
+
+#ifdef RANGESLIDERS_AVX2
+    RANGESLIDERS_TARGET_AVX2 inline quint64 wordAvx2(const float* v, const float lo, const float hi)
+    {
+        const __m256 vLo = _mm256_set1_ps(lo);
+        const __m256 vHi = _mm256_set1_ps(hi);
+        quint64 word = 0;
+        for(int b=0;b<64;b+=8)
+        {
+            const __m256 x = _mm256_loadu_ps(v + b);
+            const __m256 in = _mm256_and_ps(_mm256_cmp_ps(x, vLo, _CMP_GE_OQ), _mm256_cmp_ps(x, vHi, _CMP_LE_OQ));
+            word |= (quint64)_mm256_movemask_ps(in) << b;
+        }
+        return word;
+    }
+
+    RANGESLIDERS_TARGET_AVX2 inline quint64 wordAvx2(const double* v, const double lo, const double hi)
+    {
+        const __m256d vLo = _mm256_set1_pd(lo);
+        const __m256d vHi = _mm256_set1_pd(hi);
+        quint64 word = 0;
+        for(int b=0;b<64;b+=4)
+        {
+            const __m256d x = _mm256_loadu_pd(v + b);
+            const __m256d in = _mm256_and_pd(_mm256_cmp_pd(x, vLo, _CMP_GE_OQ), _mm256_cmp_pd(x, vHi, _CMP_LE_OQ));
+            word |= (quint64)_mm256_movemask_pd(in) << b;
+        }
+        return word;
+    }
+
+    RANGESLIDERS_TARGET_AVX2 inline quint64 wordAvx2(const int* v, const int lo, const int hi)
+    {
+        const __m256i vLo = _mm256_set1_epi32(lo);
+        const __m256i vHi = _mm256_set1_epi32(hi);
+        quint64 word = 0;
+        for(int b=0;b<64;b+=8)
+        {
+            const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + b));
+            const __m256i out = _mm256_or_si256(_mm256_cmpgt_epi32(vLo, x), _mm256_cmpgt_epi32(x, vHi));
+            word |= (quint64)(~_mm256_movemask_ps(_mm256_castsi256_ps(out)) & 0xFF) << b;
+        }
+        return word;
+    }
+
+    RANGESLIDERS_TARGET_AVX2 inline quint64 wordAvx2(const qint64* v, const qint64 lo, const qint64 hi)
+    {
+        const __m256i vLo = _mm256_set1_epi64x(lo);
+        const __m256i vHi = _mm256_set1_epi64x(hi);
+        quint64 word = 0;
+        for(int b=0;b<64;b+=4)
+        {
+            const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + b));
+            const __m256i out = _mm256_or_si256(_mm256_cmpgt_epi64(vLo, x), _mm256_cmpgt_epi64(x, vHi));
+            word |= (quint64)(~_mm256_movemask_pd(_mm256_castsi256_pd(out)) & 0xF) << b;
+        }
+        return word;
+    }
+
+    template<typename T>
+    RANGESLIDERS_TARGET_AVX2 qint64 scanAvx2(const T* v, const qint64 count, const T lo, const T hi, quint64* words)
+    {
+        qint64 selected = 0;
+        qint64 i = 0;
+        for(;i+64<=count;i+=64)
+        {
+            const quint64 word = wordAvx2(v + i, lo, hi);
+            words[i >> 6] = word;
+            selected += qPopulationCount(word);
+        }
+
+        return selected + scanScalar(v + i, count - i, lo, hi, words + (i >> 6));
+    }
+#endif
+
+    template<typename T>
+    qint64 scan(const T* v, const qint64 count, const T lo, const T hi, quint64* words)
+    {
+#ifdef RANGESLIDERS_AVX2
+        if(simdHasAvx2()) return scanAvx2(v, count, lo, hi, words);
+#endif
+#ifdef RANGESLIDERS_SSE2
+        return scanSse2(v, count, lo, hi, words);
+#else
+        return scanScalar(v, count, lo, hi, words);
+#endif
+    }
+
+    template<typename T>
+    RangeFilter::Index computeIndex(const T* values, const qint64 count, const quint64 generation, QSharedPointer<QAtomicInt> cancel)
+    {
+        RangeFilter::Index index;
+        index.generation = generation;
+        if(count > indexRowLimit) return index;
+
+        QVector<quint32> order;
+        order.reserve(count);
+        for(qint64 i=0;i<count;i++)
+            if(values[i] == values[i]) order.append((quint32)i);
+
+        if(cancel->load()) return index;
+
+        parallelSort(order, [values](const quint32 a, const quint32 b) { return values[a] < values[b]; }, cancel.data());
+        if(cancel->load()) return index;
+
+        index.order = order;
+        return index;
+    }
+}
+
+RangeFilter::RangeFilter(QObject* parent) :
+    QObject(parent),
+    mType(NoColumn),
+    mValues(nullptr),
+    mCount(0),
+    mLo(0.0),
+    mHi(0.0),
+    mSelectedCount(0),
+    mSelectionValid(false),
+    mFirst(-1),
+    mLast(-1),
+    mJob(this)
+{
+    mJob.onFinished(this, &RangeFilter::slotIndexFinished);
+}
+
+void RangeFilter::setColumn(const int* values, const qint64 count)
+{
+    start(values, count, Int32);
+}
+
+void RangeFilter::setColumn(const qint64* values, const qint64 count)
+{
+    start(values, count, Int64);
+}
+
+void RangeFilter::setColumn(const float* values, const qint64 count)
+{
+    start(values, count, Float);
+}
+
+void RangeFilter::setColumn(const double* values, const qint64 count)
+{
+    start(values, count, Double);
+}
+
+void RangeFilter::clearColumn()
+{
+    start<int>(nullptr, 0, NoColumn);
+}
+
+void RangeFilter::attach(RangeSlider* slider)
+{
+    connect(slider, &RangeSlider::rangeCommitted, this, [this](const int lo, const int hi) { setBounds(lo, hi); });
+    setBounds(slider->valueLo(), slider->valueHi());
+}
+
+template<typename T>
+void RangeFilter::start(const T* values, const qint64 count, const ColumnType type)
+{
+    mJob.cancel();
+
+    mType = type;
+    mValues = values;
+    mCount = count;
+    mSelection.fill(0, (count + 63) / 64);
+    mSelectedCount = 0;
+    mSelectionValid = false;
+    mOrder.clear();
+    mFirst = mLast = -1;
+
+    if(type == NoColumn)
+    {
+        emit selectionChanged(0);
+        return;
+    }
+
+    setBounds(mLo, mHi);
+    mJob.setFuture(QtConcurrent::run(&computeIndex<T>, values, count, mJob.generation(), mJob.cancelFlag()));
+}
+
+void RangeFilter::slotIndexFinished()
+{
+    const Index index = mJob.result();
+    if(index.generation != mJob.generation() || index.order.isEmpty()) return;
+
+    mOrder = index.order;
+
+    // find where the current selection sits in the permutation
+    mFirst = mLast = -1;
+    if(mSelectionValid)
+    {
+        switch(mType)
+        {
+        case Int32: locate<int>(mFirst, mLast); break;
+        case Int64: locate<qint64>(mFirst, mLast); break;
+        case Float: locate<float>(mFirst, mLast); break;
+        case Double: locate<double>(mFirst, mLast); break;
+        default: break;
+        }
+    }
+
+    emit indexReady();
+}
+
+void RangeFilter::setBounds(const double lo, const double hi)
+{
+    if(mSelectionValid && lo == mLo && hi == mHi) return;
+
+    mLo = lo;
+    mHi = hi;
+
+    switch(mType)
+    {
+    case Int32: update<int>(); break;
+    case Int64: update<qint64>(); break;
+    case Float: update<float>(); break;
+    case Double: update<double>(); break;
+    default: return;
+    }
+
+    emit selectionChanged(mSelectedCount);
+}
+
+template<typename T>
+void RangeFilter::locate(qint64& first, qint64& last) const
+{
+    T lo, hi;
+    if(!columnBounds(mLo, mHi, lo, hi))
+    {
+        first = last = 0;
+        return;
+    }
+
+    const T* values = static_cast<const T*>(mValues);
+    const quint32* order = mOrder.constData();
+    first = std::partition_point(order, order + mOrder.size(), [=](const quint32 row) { return values[row] < lo; }) - order;
+    last = std::partition_point(order + first, order + mOrder.size(), [=](const quint32 row) { return values[row] <= hi; }) - order;
+}
+
+void RangeFilter::flip(const qint64 from, const qint64 to)
+{
+    quint64* words = mSelection.data();
+    const quint32* order = mOrder.constData();
+    for(qint64 i=from;i<to;i++)
+        words[order[i] >> 6] ^= Q_UINT64_C(1) << (order[i] & 63);
+}
+
+template<typename T>
+void RangeFilter::update()
+{
+    if(hasIndex())
+    {
+        qint64 first, last;
+        locate<T>(first, last);
+
+        // [first, last) xor [mFirst, mLast) = [first, mFirst) xor [last, mLast), in either order
+        const qint64 flips = qAbs(first - mFirst) + qAbs(last - mLast);
+        if(mSelectionValid && mFirst != -1 && flips <= mCount / 16)
+        {
+            flip(qMin(first, mFirst), qMax(first, mFirst));
+            flip(qMin(last, mLast), qMax(last, mLast));
+            mSelectedCount = last - first;
+            mStatistics.incrementalUpdates++;
+            mStatistics.rowsFlipped += flips;
+        }
+        else
+        {
+            fullScan<T>();
+        }
+
+        mFirst = first;
+        mLast = last;
+        return;
+    }
+
+    fullScan<T>();
+}
+
+template<typename T>
+void RangeFilter::fullScan()
+{
+    mSelectionValid = true;
+    mStatistics.fullScans++;
+
+    T lo, hi;
+    if(!columnBounds(mLo, mHi, lo, hi))
+    {
+        mSelection.fill(0);
+        mSelectedCount = 0;
+        return;
+    }
+
+    QVector<Chunk> chunks;
+    for(qint64 first=0;first<mCount;first+=chunkSize)
+    {
+        Chunk chunk;
+        chunk.first = first;
+        chunk.count = qMin(chunkSize, mCount - first);
+        chunk.selected = 0;
+        chunks.append(chunk);
+    }
+
+    const T* values = static_cast<const T*>(mValues);
+    quint64* words = mSelection.data();
+    QtConcurrent::blockingMap(chunks, [&](Chunk& chunk)
+    {
+        chunk.selected = scan(values + chunk.first, chunk.count, lo, hi, words + (chunk.first >> 6));
+    });
+
+    mSelectedCount = 0;
+    for(int c=0;c<chunks.size();c++)
+        mSelectedCount += chunks[c].selected;
+}
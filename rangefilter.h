@@ -0,0 +1,115 @@
+#ifndef RANGEFILTER_H
+#define RANGEFILTER_H
+
+#include <QObject>
+#include <QVector>
+
+#include "backgroundjob.h"
+
+class RangeSlider;
+
+// Selects the rows of a numeric column whose value lies in [lo, hi], as a bitmask with one bit per
+// row. A full scan runs SSE2/AVX2 kernels over chunks of the column on the global thread pool.
+//
+// After setColumn(), a permutation of the rows sorted by value is built in the background. Once it
+// is ready, moving a bound only flips the rows between the old and the new bound: the selection
+// is the interval [first, last) of that permutation, and two binary searches tell how far each
+// end moved. Large jumps still fall back to a full scan, which is cheaper then.
+//
+// NaNs are never selected. Bounds are doubles, so 64 bit columns compare exactly only within
+// +/-2^53.
+class RangeFilter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum ColumnType
+    {
+        NoColumn,
+        Int32,
+        Int64,
+        Float,
+        Double
+    };
+
+    struct Statistics
+    {
+        Statistics() : fullScans(0), incrementalUpdates(0), rowsFlipped(0) { }
+
+        quint64 fullScans;
+        quint64 incrementalUpdates;
+        quint64 rowsFlipped;
+    };
+
+    // what the background job hands back
+    struct Index
+    {
+        Index() : generation(0) { }
+
+        quint64 generation;
+        QVector<quint32> order; // rows sorted by value, without NaNs
+    };
+
+    explicit RangeFilter(QObject* parent = nullptr);
+
+    // The values must stay valid until setColumn() or clearColumn() is called again, or this
+    // object is destroyed.
+    void setColumn(const int* values, const qint64 count);
+    void setColumn(const qint64* values, const qint64 count);
+    void setColumn(const float* values, const qint64 count);
+    void setColumn(const double* values, const qint64 count);
+    void clearColumn();
+
+    // Filters to the slider's range now and whenever it is committed.
+    void attach(RangeSlider* slider);
+
+    ColumnType columnType() const { return mType; }
+    qint64 rowCount() const { return mCount; }
+    double lo() const { return mLo; }
+    double hi() const { return mHi; }
+
+    // bit (row % 64) of word (row / 64) is set for selected rows
+    const QVector<quint64>& selection() const { return mSelection; }
+    bool isSelected(const qint64 row) const { return (mSelection.at(row >> 6) >> (row & 63)) & 1; }
+    qint64 selectedCount() const { return mSelectedCount; }
+
+    bool hasIndex() const { return !mOrder.isEmpty(); }
+    const Statistics& statistics() const { return mStatistics; }
+
+public slots:
+    void setBounds(const double lo, const double hi);
+
+signals:
+    void selectionChanged(qint64 selectedCount);
+
+    // the sorted permutation is ready, from now on bounds are updated incrementally
+    void indexReady();
+
+private slots:
+    void slotIndexFinished();
+
+private:
+    template<typename T> void start(const T* values, const qint64 count, const ColumnType type);
+    template<typename T> void update();
+    template<typename T> void fullScan();
+    template<typename T> void locate(qint64& first, qint64& last) const; // of the current bounds
+    void flip(const qint64 from, const qint64 to);
+
+    ColumnType mType;
+    const void* mValues;
+    qint64 mCount;
+    double mLo, mHi;
+
+    QVector<quint64> mSelection;
+    qint64 mSelectedCount;
+    bool mSelectionValid; // mSelection matches mLo and mHi
+
+    // the selection is [mFirst, mLast) of mOrder, -1 while unknown
+    QVector<quint32> mOrder;
+    qint64 mFirst, mLast;
+
+    Statistics mStatistics;
+    BackgroundJob<Index> mJob;
+};
+
+#endif // RANGEFILTER_H
@@ -0,0 +1,184 @@
+#include "rangehistogram.h"
+
+#include <QtConcurrent>
+
+#include <limits>
+
+namespace
+{
+    // values per job, large enough to keep the per-chunk bins and scheduling cheap
+    const qint64 chunkSize = 1 << 20;
+
+    struct Chunk
+    {
+        qint64 first, count;
+        double minimum, maximum;
+        QVector<quint64> bins;
+    };
+
+    template<typename T>
+    RangeHistogram::Result computeHistogram(const T* values, const qint64 count, const int binCount, const quint64 generation, QSharedPointer<QAtomicInt> cancel)
+    {
+        const double infinity = std::numeric_limits<double>::infinity();
+
+        RangeHistogram::Result result;
+        result.generation = generation;
+        result.bins.fill(0, binCount);
+
+        QVector<Chunk> chunks;
+        for(qint64 first=0;first<count;first+=chunkSize)
+        {
+            Chunk chunk;
+            chunk.first = first;
+            chunk.count = qMin(chunkSize, count - first);
+            chunk.minimum = infinity;
+            chunk.maximum = -infinity;
+            chunks.append(chunk);
+        }
+
+        // first pass: the extent of the data
+        QtConcurrent::blockingMap(chunks, [&](Chunk& chunk)
+        {
+            if(cancel->load()) return;
+
+            const T* v = values + chunk.first;
+            double lo = infinity, hi = -infinity;
+            for(qint64 i=0;i<chunk.count;i++)
+            {
+                const double x = v[i];
+                if(x < lo) lo = x; // NaNs fail both comparisons
+                if(x > hi) hi = x;
+            }
+            chunk.minimum = lo;
+            chunk.maximum = hi;
+        });
+
+        double minimum = infinity, maximum = -infinity;
+        for(int c=0;c<chunks.size();c++)
+        {
+            minimum = qMin(minimum, chunks[c].minimum);
+            maximum = qMax(maximum, chunks[c].maximum);
+        }
+
+        // nothing but NaNs, or no data at all
+        if(cancel->load() || minimum > maximum) return result;
+
+        result.minimum = minimum;
+        result.maximum = maximum;
+
+        // second pass: every chunk counts into its own bins, so there's no contention
+        const double scale = maximum > minimum ? binCount / (maximum - minimum) : 0.0;
+        QtConcurrent::blockingMap(chunks, [&](Chunk& chunk)
+        {
+            chunk.bins.fill(0, binCount);
+            if(cancel->load()) return;
+
+            quint64* bins = chunk.bins.data();
+            const T* v = values + chunk.first;
+            for(qint64 i=0;i<chunk.count;i++)
+            {
+                const double x = v[i];
+                if(x != x) continue;
+                int bin = (int)((x - minimum) * scale);
+                if(bin >= binCount) bin = binCount - 1; // x == maximum
+                bins[bin]++;
+            }
+        });
+
+        for(int c=0;c<chunks.size();c++)
+        {
+            const quint64* bins = chunks[c].bins.constData();
+            for(int b=0;b<binCount;b++)
+            {
+                result.bins[b] += bins[b];
+                result.total += bins[b];
+            }
+        }
+
+        return result;
+    }
+}
+
+RangeHistogram::RangeHistogram(QObject* parent, const int baseBins) :
+    QObject(parent),
+    mBaseBinCount(qMax(1, baseBins)),
+    mJob(this)
+{
+    mJob.onFinished(this, &RangeHistogram::slotFinished);
+}
+
+void RangeHistogram::setData(const float* values, const qint64 count)
+{
+    start(values, count);
+}
+
+void RangeHistogram::setData(const double* values, const qint64 count)
+{
+    start(values, count);
+}
+
+void RangeHistogram::setData(const int* values, const qint64 count)
+{
+    start(values, count);
+}
+
+template<typename T>
+void RangeHistogram::start(const T* values, const qint64 count)
+{
+    mJob.cancel();
+    mJob.setFuture(QtConcurrent::run(&computeHistogram<T>, values, count, mBaseBinCount, mJob.generation(), mJob.cancelFlag()));
+}
+
+void RangeHistogram::clear()
+{
+    mJob.cancel();
+    mResult = Result();
+    mCumulative.clear();
+    emit changed();
+}
+
+void RangeHistogram::slotFinished()
+{
+    const Result result = mJob.result();
+    if(result.generation != mJob.generation()) return;
+
+    mResult = result;
+
+    mCumulative.resize(mResult.bins.size() + 1);
+    mCumulative[0] = 0.0;
+    for(int i=0;i<mResult.bins.size();i++)
+        mCumulative[i + 1] = mCumulative[i] + mResult.bins[i];
+
+    emit changed();
+}
+
+double RangeHistogram::cumulative(const double x) const
+{
+    if(!(mResult.maximum > mResult.minimum))
+        return x < mResult.minimum ? 0.0 : (double)mResult.total;
+
+    const int binCount = mResult.bins.size();
+    const double f = (x - mResult.minimum) / (mResult.maximum - mResult.minimum) * binCount;
+    if(f <= 0.0) return 0.0;
+    if(f >= binCount) return mResult.total;
+
+    // assume the values are spread evenly within a bin
+    const int bin = (int)f;
+    return mCumulative[bin] + (f - bin) * mResult.bins[bin];
+}
+
+QVector<float> RangeHistogram::resample(const double lo, const double hi, const int bins) const
+{
+    QVector<float> result(qMax(0, bins), 0.0f);
+    if(!isReady() || bins <= 0 || !(hi > lo)) return result;
+
+    const double step = (hi - lo) / bins;
+    double below = cumulative(lo);
+    for(int i=0;i<bins;i++)
+    {
+        const double next = cumulative(lo + (i + 1) * step);
+        result[i] = next - below;
+        below = next;
+    }
+    return result;
+}
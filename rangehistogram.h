@@ -0,0 +1,70 @@
+#ifndef RANGEHISTOGRAM_H
+#define RANGEHISTOGRAM_H
+
+#include <QObject>
+#include <QVector>
+
+#include "backgroundjob.h"
+
+// Counts how a (possibly huge) column of values is distributed, so a RangeSlider can draw it into
+// its groove. Binning runs in parallel chunks on the global thread pool, changed() is emitted on the
+// thread owning this object once the result arrived.
+//
+// The counts go into a fine base histogram over the data's full extent. Showing any other window
+// (e.g. while a FloatingRangeSlider animates its minimum and maximum) only resamples those bins,
+// the data isn't touched again.
+class RangeHistogram : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Result
+    {
+        Result() : generation(0), minimum(0), maximum(0), total(0) { }
+
+        quint64 generation;
+        double minimum, maximum;
+        quint64 total; // values that were binned, NaNs are skipped
+        QVector<quint64> bins;
+    };
+
+    explicit RangeHistogram(QObject* parent = nullptr, const int baseBins = 4096);
+
+    // The values must stay valid until changed() was emitted, setData() or clear() was called
+    // again, or this object is destroyed.
+    void setData(const float* values, const qint64 count);
+    void setData(const double* values, const qint64 count);
+    void setData(const int* values, const qint64 count);
+    void clear();
+
+    bool isReady() const { return mResult.generation != 0 && mResult.generation == mJob.generation(); }
+    quint64 generation() const { return mJob.generation(); }
+    double dataMinimum() const { return mResult.minimum; }
+    double dataMaximum() const { return mResult.maximum; }
+    quint64 total() const { return mResult.total; }
+    const QVector<quint64>& baseBins() const { return mResult.bins; }
+
+    // Returns bins equally wide counts covering [lo, hi]. Base bins that are only partially
+    // covered are split proportionally, so this costs O(bins), no matter how much data there is.
+    QVector<float> resample(const double lo, const double hi, const int bins) const;
+
+signals:
+    // a new result arrived, or the histogram was cleared
+    void changed();
+
+private slots:
+    void slotFinished();
+
+private:
+    template<typename T> void start(const T* values, const qint64 count);
+
+    // number of values <= x, interpolated from the cumulative base histogram
+    double cumulative(const double x) const;
+
+    int mBaseBinCount;
+    Result mResult;
+    QVector<double> mCumulative; // mCumulative[i] = values in base bins [0, i)
+    BackgroundJob<Result> mJob;
+};
+
+#endif // RANGEHISTOGRAM_H
@@ -0,0 +1,82 @@
+#ifndef RANGEMODEL_H
+#define RANGEMODEL_H
+
+#include <QtGlobal>
+
+#include <atomic>
+
+// The values of a range slider, readable from any thread. The GUI thread is the only writer, worker
+// threads (rendering, queries) take consistent snapshots without locks and without going through
+// the event loop.
+//
+// Publishing is a seqlock: the sequence is odd while a write is in progress, and a reader retries
+// when it started during a write or the sequence moved while it was reading. The writer never
+// waits. A reader only retries while the writer is in the middle of storing four ints, so in
+// practice snapshot() returns on the first pass.
+class RangeModel
+{
+public:
+    struct Snapshot
+    {
+        Snapshot() : minimum(0), maximum(0), valueLo(0), valueHi(0), generation(0) { }
+
+        int minimum, maximum;
+        int valueLo, valueHi;
+        quint64 generation; // increases with every published change
+    };
+
+    RangeModel() : mSequence(0), mMinimum(0), mMaximum(0), mValueLo(0), mValueHi(0) { }
+
+    // Any thread
+    Snapshot snapshot() const
+    {
+        Snapshot s;
+        quint64 before, after;
+        do
+        {
+            before = mSequence.load(std::memory_order_acquire);
+            s.minimum = mMinimum.load(std::memory_order_relaxed);
+            s.maximum = mMaximum.load(std::memory_order_relaxed);
+            s.valueLo = mValueLo.load(std::memory_order_relaxed);
+            s.valueHi = mValueHi.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = mSequence.load(std::memory_order_relaxed);
+        } while((before & 1) || before != after);
+
+        s.generation = before >> 1;
+        return s;
+    }
+
+    // Any thread. Cheap enough to poll, compare with the generation of the last snapshot.
+    quint64 generation() const { return mSequence.load(std::memory_order_acquire) >> 1; }
+
+    // Writer thread only. Does nothing (and keeps the generation) if nothing changed.
+    void publish(const int minimum, const int maximum, const int valueLo, const int valueHi)
+    {
+        if(minimum == mMinimum.load(std::memory_order_relaxed)
+                && maximum == mMaximum.load(std::memory_order_relaxed)
+                && valueLo == mValueLo.load(std::memory_order_relaxed)
+                && valueHi == mValueHi.load(std::memory_order_relaxed))
+            return;
+
+        const quint64 sequence = mSequence.load(std::memory_order_relaxed);
+        mSequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        mMinimum.store(minimum, std::memory_order_relaxed);
+        mMaximum.store(maximum, std::memory_order_relaxed);
+        mValueLo.store(valueLo, std::memory_order_relaxed);
+        mValueHi.store(valueHi, std::memory_order_relaxed);
+
+        mSequence.store(sequence + 2, std::memory_order_release);
+    }
+
+private:
+    Q_DISABLE_COPY(RangeModel)
+
+    std::atomic<quint64> mSequence;
+    std::atomic<int> mMinimum, mMaximum;
+    std::atomic<int> mValueLo, mValueHi;
+};
+
+#endif // RANGEMODEL_H
@@ -0,0 +1,98 @@
+#include "rangequery.h"
+#include "rangeslider.h"
+
+#include <QtConcurrent>
+#include <QThreadPool>
+
+namespace
+{
+    RangeQuery::Outcome runQuery(const RangeQuery::Function& function, const int valueLo, const int valueHi, QSharedPointer<QAtomicInt> stale)
+    {
+        RangeQuery::Outcome outcome;
+        outcome.valueLo = valueLo;
+        outcome.valueHi = valueHi;
+        if(!stale->load()) outcome.value = function(valueLo, valueHi, *stale);
+        outcome.stale = stale->load();
+        return outcome;
+    }
+}
+
+RangeQuery::RangeQuery(const Function& function, QObject* parent) :
+    QObject(parent),
+    mFunction(function),
+    mThreadPool(nullptr),
+    mCancelStale(true),
+    mRunning(false),
+    mPending(false),
+    mPendingLo(0),
+    mPendingHi(0),
+    mStale(new QAtomicInt(0))
+{
+    mWatcher = new QFutureWatcher<Outcome>(this);
+    connect(mWatcher, &QFutureWatcher<Outcome>::finished, this, &RangeQuery::slotFinished);
+}
+
+RangeQuery::~RangeQuery()
+{
+    // the function likely uses data owned by the caller, don't let it outlive us
+    mStale->store(1);
+    mWatcher->waitForFinished();
+}
+
+void RangeQuery::attach(RangeSlider* slider)
+{
+    connect(slider, &RangeSlider::rangeCommitted, this, &RangeQuery::request);
+    request(slider->valueLo(), slider->valueHi());
+}
+
+void RangeQuery::request(int valueLo, int valueHi)
+{
+    mStatistics.requested++;
+
+    if(!mRunning)
+    {
+        start(valueLo, valueHi);
+        return;
+    }
+
+    // only the newest range waits for the running call
+    if(mPending) mStatistics.dropped++;
+    mPending = true;
+    mPendingLo = valueLo;
+    mPendingHi = valueHi;
+
+    if(mCancelStale) mStale->store(1);
+}
+
+void RangeQuery::start(const int valueLo, const int valueHi)
+{
+    mStale = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+    mRunning = true;
+    mStatistics.started++;
+
+    QThreadPool* pool = mThreadPool ? mThreadPool : QThreadPool::globalInstance();
+    mWatcher->setFuture(QtConcurrent::run(pool, &runQuery, mFunction, valueLo, valueHi, mStale));
+}
+
+void RangeQuery::slotFinished()
+{
+    const Outcome outcome = mWatcher->result();
+    mRunning = false;
+
+    // start the next one before telling anyone, a slot may request another range right away
+    if(mPending)
+    {
+        mPending = false;
+        start(mPendingLo, mPendingHi);
+    }
+
+    if(outcome.stale)
+    {
+        mStatistics.cancelled++;
+        return;
+    }
+
+    mStatistics.delivered++;
+    mResult = outcome.value;
+    emit resultReady(outcome.valueLo, outcome.valueHi, outcome.value);
+}
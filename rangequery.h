@@ -0,0 +1,100 @@
+#ifndef RANGEQUERY_H
+#define RANGEQUERY_H
+
+#include <QObject>
+#include <QVariant>
+#include <QFutureWatcher>
+#include <QSharedPointer>
+#include <QAtomicInt>
+
+#include <functional>
+
+class QThreadPool;
+class RangeSlider;
+
+// Runs an expensive function of a range (re-filtering a table, say) on a thread pool instead of in
+// a slot on the GUI thread, so a slow query doesn't freeze the drag.
+//
+// At most one call runs at a time. Ranges requested meanwhile don't queue up: only the newest one
+// is kept and started when the running call returns, the ones it replaced are dropped. The running
+// call is marked stale as soon as a newer range arrives. The function may poll that flag and
+// return early, either way its result is thrown away. resultReady() therefore only ever delivers
+// the result for the newest range, on the thread owning this object.
+class RangeQuery : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Called on a pool thread. stale becomes non-zero when the result isn't wanted anymore.
+    typedef std::function<QVariant(int valueLo, int valueHi, const QAtomicInt& stale)> Function;
+
+    struct Statistics
+    {
+        Statistics() : requested(0), started(0), delivered(0), dropped(0), cancelled(0) { }
+
+        quint64 requested;
+        quint64 started;
+        quint64 delivered;
+        quint64 dropped; // replaced by a newer range before they started
+        quint64 cancelled; // superseded while running, result discarded
+    };
+
+    // what a call hands back to the GUI thread
+    struct Outcome
+    {
+        Outcome() : valueLo(0), valueHi(0), stale(false) { }
+
+        int valueLo, valueHi;
+        bool stale;
+        QVariant value;
+    };
+
+    explicit RangeQuery(const Function& function, QObject* parent = nullptr);
+    ~RangeQuery();
+
+    // Requests the slider's range now and whenever it is committed.
+    void attach(RangeSlider* slider);
+
+    // nullptr means QThreadPool::globalInstance()
+    void setThreadPool(QThreadPool* pool) { mThreadPool = pool; }
+
+    // When disabled, a running call is allowed to finish and its result is delivered even if a
+    // newer range is waiting, which shows intermediate results during long drags.
+    void setCancelStale(const bool cancel) { mCancelStale = cancel; }
+    bool cancelStale() const { return mCancelStale; }
+
+    // calls running plus ranges waiting, 0 to 2
+    int queueDepth() const { return (mRunning ? 1 : 0) + (mPending ? 1 : 0); }
+    bool isBusy() const { return mRunning; }
+    const Statistics& statistics() const { return mStatistics; }
+
+    // the last delivered result
+    QVariant result() const { return mResult; }
+
+public slots:
+    void request(int valueLo, int valueHi);
+
+signals:
+    void resultReady(int valueLo, int valueHi, const QVariant& result);
+
+private slots:
+    void slotFinished();
+
+private:
+    void start(const int valueLo, const int valueHi);
+
+    Function mFunction;
+    QThreadPool* mThreadPool;
+    bool mCancelStale;
+
+    bool mRunning;
+    bool mPending;
+    int mPendingLo, mPendingHi;
+    QSharedPointer<QAtomicInt> mStale; // of the running call
+
+    QVariant mResult;
+    Statistics mStatistics;
+    QFutureWatcher<Outcome>* mWatcher;
+};
+
+#endif // RANGEQUERY_H
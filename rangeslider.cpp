@@ -1,76 +1,230 @@
 #include "rangeslider.h"
+#include "rangehistogram.h"
+#include "gradientrasterizer.h"
+#include "rangeanimationdriver.h"
+#include "widgetstats.h"
 
 #include <QMouseEvent>
 #include <QDebug>
 #include <QPainter>
 #include <QKeyEvent>
 
+#include <limits>
+
+namespace
+{
+    // FloatingRangeSlider keeps growing its range, saturate instead of overflowing
+    int boundedToInt(const qint64 value)
+    {
+        return (int)qBound((qint64)std::numeric_limits<int>::min(), value, (qint64)std::numeric_limits<int>::max());
+    }
+}
+
 RangeSlider::RangeSlider(const int rangeMin, const int rangeMax, const int valueLo, const int valueHi) :
-    mValueLo(valueLo),
-    mValueHi(valueHi),
+    mMinimum(0),
+    mMaximum(0),
+    mVisualMinimum(0),
+    mVisualMaximum(0),
+    mValueLo(0),
+    mValueHi(0),
+    mDrawnValueLo(0),
+    mDrawnValueHi(0),
     mSizeSingleStep(1),
     mSizePageStep(10),
-    mMouseMovementMode(Disabled)
+    mMouseMovementMode(Disabled),
+    mDragMode(ImmediateDrag),
+    mDragSampleTime(0),
+    mDragSamplePixel(0),
+    mDragVelocity(0),
+    mHistogramPeak(0),
+    mHistogramBinsMinimum(0),
+    mHistogramBinsMaximum(0),
+    mHistogramBinsGeneration(0),
+    mModel(new RangeModel)
 {
+    mCommitTimer = new QTimer(this);
+    mCommitTimer->setSingleShot(true);
+    mCommitTimer->setInterval(0);
+    connect(mCommitTimer, &QTimer::timeout, this, &RangeSlider::slotCommit);
+
+    mDragTimer = new QTimer(this);
+    mDragTimer->setSingleShot(true);
+    mDragTimer->setInterval(0);
+    connect(mDragTimer, &QTimer::timeout, this, &RangeSlider::slotApplyDrag);
+
     setOrientation(Qt::Horizontal);
     setRange(rangeMin, rangeMax);
+    setValues(valueLo, valueHi);
     setFocusPolicy(Qt::StrongFocus);
+
+    // nobody can be listening yet, don't commit the initial values
+    mCommitTimer->stop();
+    mCommittedValueLo = mValueLo;
+    mCommittedValueHi = mValueHi;
 }
 
 void RangeSlider::setOrientation(const Qt::Orientation orientation)
 {
     mOrientation = orientation;
-
-    // Determine size of slider handle
-    QStyleOptionSlider opt;
-    initStyleOption(&opt);
+    invalidateSliderGeometry(); // the handle size depends on the orientation
 
     if(mOrientation == Qt::Horizontal)
-    {
         setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
-        mSliderHandleSize = style()->subControlRect(QStyle::CC_Slider, &opt, QStyle::SC_SliderHandle, this).size();
-    }
     else
-    {
         setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Expanding);
-        mSliderHandleSize = style()->subControlRect(QStyle::CC_Slider, &opt, QStyle::SC_SliderHandle, this).size();
-    }
 
     updateGeometry();
     update();
 }
 
 void RangeSlider::setValueLo(int valueLo)
+{
+    setValues(valueLo, mValueHi);
+}
+
+void RangeSlider::setValueHi(int valueHi)
+{
+    setValues(mValueLo, valueHi);
+}
+
+void RangeSlider::setValues(int valueLo, int valueHi)
 {
     valueLo = qBound(mMinimum, valueLo, mMaximum);
-    if(valueLo <= mValueHi)
+    valueHi = qBound(mMinimum, valueHi, mMaximum);
+    if(valueLo > valueHi) qSwap(valueLo, valueHi);
+
+    const bool changedLo = valueLo != mValueLo;
+    const bool changedHi = valueHi != mValueHi;
+    if(!changedLo && !changedHi)
     {
-        mValueLo = valueLo;
+        WidgetStats::count(this, WidgetStats::Dropped);
+        return;
     }
-    else
+
+    // set both before telling anyone, so no slot ever sees a half-updated range
+    const int oldLo = mDrawnValueLo;
+    const int oldHi = mDrawnValueHi;
+    mValueLo = mDrawnValueLo = valueLo;
+    mValueHi = mDrawnValueHi = valueHi;
+
+    if(changedLo)
+    {
+        WidgetStats::emitted(this, "valueLoChanged");
+        emit valueLoChanged(mValueLo);
+    }
+    if(changedHi)
     {
-        mValueLo = mValueHi;
-        mValueHi = valueLo;
+        WidgetStats::emitted(this, "valueHiChanged");
         emit valueHiChanged(mValueHi);
     }
-    emit valueLoChanged(mValueLo);
-    update();
+
+    publish();
+    scheduleCommit();
+    update(valuesChangedRegion(oldLo, oldHi));
 }
 
-void RangeSlider::setValueHi(int valueHi)
+void RangeSlider::setDrawnValues(const int valueLo, const int valueHi)
 {
-    valueHi = qBound(mMinimum, valueHi, mMaximum);
-    if(valueHi >= mValueLo)
-    {
-        mValueHi = valueHi;
-    }
-    else
+    if(valueLo == mDrawnValueLo && valueHi == mDrawnValueHi) return;
+
+    const int oldLo = mDrawnValueLo;
+    const int oldHi = mDrawnValueHi;
+    mDrawnValueLo = valueLo;
+    mDrawnValueHi = valueHi;
+    update(valuesChangedRegion(oldLo, oldHi));
+}
+
+QRect RangeSlider::handleRect(const int value) const
+{
+    const SliderGeometry& g = sliderGeometry();
+    return QRect(g.toPixel(value), 0, g.handleSize.width(), height());
+}
+
+void RangeSlider::SliderGeometry::setRange(const int min, const int max)
+{
+    minimum = min;
+    maximum = qMax(min, max);
+    option.minimum = minimum;
+    option.maximum = maximum;
+
+    // an empty range maps everything to 0 and can't be dragged
+    const quint64 range = (quint64)((qint64)maximum - minimum);
+    pixelScale.set(range ? pixels : 0, range);
+    widthScale.set(range ? width : 0, range);
+    valueScale.set(range, pixels);
+}
+
+void RangeSlider::setVisualRange(const int min, const int max)
+{
+    mVisualMinimum = min;
+    mVisualMaximum = max;
+
+    // only the scales depend on the range, no need to ask the style again
+    if(mSliderGeometry.valid) mSliderGeometry.setRange(min, max);
+}
+
+const RangeSlider::SliderGeometry& RangeSlider::sliderGeometry() const
+{
+    // there is no change event for moving to another screen, so check that here
+    const qreal devicePixelRatio = devicePixelRatioF();
+    const int logicalDpi = logicalDpiX();
+    if(mSliderGeometry.valid && mSliderGeometry.devicePixelRatio == devicePixelRatio && mSliderGeometry.logicalDpi == logicalDpi) return mSliderGeometry;
+
+    SliderGeometry& g = mSliderGeometry;
+    g.devicePixelRatio = devicePixelRatio;
+    g.logicalDpi = logicalDpi;
+    initStyleOption(&g.option);
+    g.handleSize = style()->subControlRect(QStyle::CC_Slider, &g.option, QStyle::SC_SliderHandle, this).size();
+    g.width = qMax(0, rect().width());
+    g.pixels = qMax(0, g.width - g.handleSize.width());
+    g.setRange(mVisualMinimum, mVisualMaximum);
+    g.valid = true;
+    return g;
+}
+
+QRegion RangeSlider::valuesChangedRegion(const int oldLo, const int oldHi) const
+{
+    if(mOrientation != Qt::Horizontal) return rect();
+
+    // The range rectangle's edges lie within the handles, so a moved handle's old and new rects
+    // cover everything that changed. The margin is for frames and antialiasing.
+    QRegion region;
+    if(oldLo != mDrawnValueLo) region |= (handleRect(oldLo) | handleRect(mDrawnValueLo)).adjusted(-2, 0, 2, 0);
+    if(oldHi != mDrawnValueHi) region |= (handleRect(oldHi) | handleRect(mDrawnValueHi)).adjusted(-2, 0, 2, 0);
+    return region;
+}
+
+void RangeSlider::scheduleCommit()
+{
+    if(mCommitTimer->isActive()) WidgetStats::count(this, WidgetStats::Coalesced);
+    else mCommitTimer->start();
+}
+
+void RangeSlider::slotCommit()
+{
+    mCommitTimer->stop();
+
+    if(mValueLo == mCommittedValueLo && mValueHi == mCommittedValueHi)
     {
-        mValueHi = mValueLo;
-        mValueLo = valueHi;
-        emit valueLoChanged(mValueLo);
+        WidgetStats::count(this, WidgetStats::Dropped);
+        return;
     }
-    emit valueHiChanged(mValueHi);
+
+    mCommittedValueLo = mValueLo;
+    mCommittedValueHi = mValueHi;
+    WidgetStats::emitted(this, "rangeCommitted");
+    emit rangeCommitted(mValueLo, mValueHi);
+}
+
+void RangeSlider::setHistogram(RangeHistogram* histogram)
+{
+    if(mHistogram) disconnect(mHistogram, nullptr, this, nullptr);
+
+    mHistogram = histogram;
+    mHistogramBins.clear();
+    mHistogramBinsGeneration = 0;
+
+    if(mHistogram) connect(mHistogram, &RangeHistogram::changed, this, [this]() { update(); });
     update();
 }
 
@@ -90,10 +244,12 @@ void RangeSlider::setRange(const int min, const int max)
     int oldMax = mMaximum;
     mMinimum = qMin(min, max);
     mMaximum = qMax(min, max);
+    setVisualRange(mMinimum, mMaximum);
     if (oldMin != mMinimum || oldMax != mMaximum)
     {
-        setValueLo(mValueLo); // re-bound
-        setValueHi(mValueHi); // re-bound
+        setValues(mValueLo, mValueHi); // re-bound
+        publish(); // no-op if setValues() already did
+        WidgetStats::emitted(this, "rangeChanged");
         emit rangeChanged(mMinimum, mMaximum);
         update();
     }
@@ -109,14 +265,14 @@ QSize RangeSlider::minimumSizeHint() const
     return (mOrientation == Qt::Horizontal ? QSize(30, 20) : QSize(20, 30));
 }
 
-QRect RangeSlider::rectContainingBothSliders()
+QRect RangeSlider::rectContainingBothSliders() const
 {
     const QRect contRect(rect());
+    const SliderGeometry& g = sliderGeometry();
     if(mOrientation == Qt::Horizontal)
     {
-        int valRangePixels = contRect.width() - mSliderHandleSize.width();
-        int pixelPosOfThumbRectLeft = (float)valRangePixels / (mMaximum - mMinimum) * (mValueLo - mMinimum);
-        int pixelPosOfThumbRectRight = (float)valRangePixels / (mMaximum - mMinimum) * (mValueHi - mMinimum) + mSliderHandleSize.width();
+        int pixelPosOfThumbRectLeft = g.toPixel(mDrawnValueLo);
+        int pixelPosOfThumbRectRight = g.toPixel(mDrawnValueHi) + g.handleSize.width();
 
         return QRect(
                     contRect.x() + pixelPosOfThumbRectLeft, // left
@@ -126,13 +282,63 @@ QRect RangeSlider::rectContainingBothSliders()
     }
     else
     {
-        double valRange = contRect.height() - mSliderHandleSize.height();
-        int up = (1.0 - mValueHi) * valRange;
-        int down = (1.0 - mValueLo) * valRange; down += mSliderHandleSize.height();
+        double valRange = contRect.height() - g.handleSize.height();
+        int up = (1.0 - mDrawnValueHi) * valRange;
+        int down = (1.0 - mDrawnValueLo) * valRange; down += g.handleSize.height();
         return QRect(contRect.x(), contRect.y() + up, contRect.width(), down - up);
     }
 }
 
+void RangeSlider::resizeEvent(QResizeEvent* e)
+{
+    invalidateSliderGeometry();
+    QWidget::resizeEvent(e);
+}
+
+void RangeSlider::changeEvent(QEvent* e)
+{
+    // all of these end up in the cached style option or the handle size
+    switch(e->type())
+    {
+    case QEvent::StyleChange:
+    case QEvent::PaletteChange:
+    case QEvent::FontChange:
+    case QEvent::EnabledChange:
+    case QEvent::ActivationChange:
+    case QEvent::LayoutDirectionChange:
+        invalidateSliderGeometry();
+        update();
+        break;
+    default:
+        break;
+    }
+    QWidget::changeEvent(e);
+}
+
+void RangeSlider::focusInEvent(QFocusEvent* e)
+{
+    invalidateSliderGeometry(); // State_HasFocus
+    QWidget::focusInEvent(e);
+}
+
+void RangeSlider::focusOutEvent(QFocusEvent* e)
+{
+    invalidateSliderGeometry();
+    QWidget::focusOutEvent(e);
+}
+
+void RangeSlider::enterEvent(QEvent* e)
+{
+    invalidateSliderGeometry(); // State_MouseOver
+    QWidget::enterEvent(e);
+}
+
+void RangeSlider::leaveEvent(QEvent* e)
+{
+    invalidateSliderGeometry();
+    QWidget::leaveEvent(e);
+}
+
 void RangeSlider::mousePressEvent(QMouseEvent * e)
 {
     QRect rectBetweenHandles(rectContainingBothSliders());
@@ -154,15 +360,21 @@ void RangeSlider::mousePressEvent(QMouseEvent * e)
         return;
 
     mDragStartPosition = e->pos();
+    mDragPosition = e->pos();
+    mDragClock.start();
+    mDragSampleTime = 0;
+    mDragSamplePixel = mOrientation == Qt::Horizontal ? e->pos().x() : e->pos().y();
+    mDragVelocity = 0;
 
     mDragStartValueLo = mValueLo;
     mDragStartValueHi = mValueHi;
 
-    if(pixelsIntoRectBetweenHandles < mSliderHandleSize.width())
+    const int handleWidth = sliderGeometry().handleSize.width();
+    if(pixelsIntoRectBetweenHandles < handleWidth)
     {
         mMouseMovementMode = MoveLo;
     }
-    else if(pixelsIntoRectBetweenHandles >= lengthOfRectBetweenHandles - mSliderHandleSize.width())
+    else if(pixelsIntoRectBetweenHandles >= lengthOfRectBetweenHandles - handleWidth)
     {
         mMouseMovementMode = MoveHi;
     }
@@ -177,35 +389,119 @@ void RangeSlider::mousePressEvent(QMouseEvent * e)
 void RangeSlider::mouseMoveEvent(QMouseEvent * e)
 {
     if(!e->buttons()) return;
+    if(mMouseMovementMode == Disabled) return;
 
-    if(mMouseMovementMode != Disabled)
+    mDragPosition = e->pos();
+
+    if(mDragMode == ImmediateDrag)
     {
-        const QPoint distanceMoved = e->pos() - mDragStartPosition;
+        dragTo(mDragPosition, 0);
+        return;
+    }
+
+    // the timer fires once the queued input of this event loop iteration is through
+    if(mDragTimer->isActive() && mDragTimer->interval() == 0) WidgetStats::count(this, WidgetStats::Coalesced);
+    else mDragTimer->start(0);
+}
+
+void RangeSlider::slotApplyDrag()
+{
+    if(mMouseMovementMode == Disabled) return;
+
+    int prediction = 0;
+    const int pixel = mOrientation == Qt::Horizontal ? mDragPosition.x() : mDragPosition.y();
+    const qint64 time = mDragClock.nsecsElapsed() / 1000;
+    if(mDragMode == PredictedDrag && time > mDragSampleTime)
+    {
+        // Smoothed cursor velocity in pixels per msec. The handle is drawn where the cursor will
+        // probably be when the frame shows up, but never more than a handle width ahead.
+        const qreal velocity = (qreal)(pixel - mDragSamplePixel) * 1000 / (time - mDragSampleTime);
+        mDragVelocity = 0.5 * velocity + 0.5 * mDragVelocity;
+
+        const int limit = sliderGeometry().handleSize.width();
+        prediction = qBound(-limit, qRound(mDragVelocity * RangeAnimationDriver::instance()->frameInterval()), limit);
+    }
+    mDragSampleTime = time;
+    mDragSamplePixel = pixel;
+
+    dragTo(mDragPosition, prediction);
+
+    // when the cursor stops, the prediction decays onto it frame by frame
+    if(prediction != 0) mDragTimer->start(RangeAnimationDriver::instance()->frameInterval());
+}
+
+void RangeSlider::flushDrag()
+{
+    if(mMouseMovementMode == Disabled || mDragMode == ImmediateDrag) return;
+
+    // pending moves are applied, the handles drawn under the cursor again
+    mDragTimer->stop();
+    dragTo(mDragPosition, 0);
+}
 
-        float delta = mOrientation == Qt::Horizontal ? distanceMoved.x() : distanceMoved.y();
-        delta /= (float)(rect().width() - mSliderHandleSize.width()) / (mMaximum - mMinimum);
+void RangeSlider::dragTo(const QPoint& pos, const int extraPixels)
+{
+    const QPoint distanceMoved = pos - mDragStartPosition;
+
+    const int pixelDelta = mOrientation == Qt::Horizontal ? distanceMoved.x() : distanceMoved.y();
+    const SliderGeometry& g = sliderGeometry();
+
+    switch(mMouseMovementMode)
+    {
+    case MoveBoth:
+        setValues(g.movedByPixels(mDragStartValueLo, pixelDelta), g.movedByPixels(mDragStartValueHi, pixelDelta));
+        break;
+    case MoveHi:
+        setValueHi(g.movedByPixels(mDragStartValueHi, pixelDelta));
+        break;
+    case MoveLo:
+        setValueLo(g.movedByPixels(mDragStartValueLo, pixelDelta));
+        break;
+    default:
+        break;
+    }
 
+    // the prediction only moves what is drawn, signals, commits and the model never see it
+    int drawnLo = mValueLo, drawnHi = mValueHi;
+    if(extraPixels != 0)
+    {
         switch(mMouseMovementMode)
         {
         case MoveBoth:
-            setValueLo(mDragStartValueLo + delta);
-            setValueHi(mDragStartValueHi + delta);
+            drawnLo = g.movedByPixels(mDragStartValueLo, pixelDelta + extraPixels);
+            drawnHi = g.movedByPixels(mDragStartValueHi, pixelDelta + extraPixels);
             break;
         case MoveHi:
-            setValueHi(mDragStartValueHi + delta);
+            drawnHi = g.movedByPixels(mDragStartValueHi, pixelDelta + extraPixels);
             break;
         case MoveLo:
-            setValueLo(mDragStartValueLo + delta);
+            drawnLo = g.movedByPixels(mDragStartValueLo, pixelDelta + extraPixels);
+            break;
+        default:
             break;
         }
+        if(drawnLo > drawnHi) qSwap(drawnLo, drawnHi); // like setValues()
     }
+    setDrawnValues(drawnLo, drawnHi);
 }
 
 
 void RangeSlider::mouseReleaseEvent(QMouseEvent * e)
 {
     Q_UNUSED(e);
+
+    if(mMouseMovementMode == Disabled) return;
+    flushDrag();
     mMouseMovementMode = Disabled;
+
+    // don't make listeners wait for the timer, the drag is over
+    slotCommit();
+
+    if(mValueLo != mDragStartValueLo || mValueHi != mDragStartValueHi)
+    {
+        WidgetStats::emitted(this, "rangeFinished");
+        emit rangeFinished(mValueLo, mValueHi);
+    }
 }
 
 void RangeSlider::keyPressEvent(QKeyEvent *e)
@@ -214,21 +510,17 @@ void RangeSlider::keyPressEvent(QKeyEvent *e)
     {
     case Qt::Key_Up:
     case Qt::Key_Right:
-        setValueLo(mValueLo + mSizeSingleStep);
-        setValueHi(mValueHi + mSizeSingleStep);
+        setValues(mValueLo + mSizeSingleStep, mValueHi + mSizeSingleStep);
         break;
     case Qt::Key_Down:
     case Qt::Key_Left:
-        setValueLo(mValueLo - mSizeSingleStep);
-        setValueHi(mValueHi - mSizeSingleStep);
+        setValues(mValueLo - mSizeSingleStep, mValueHi - mSizeSingleStep);
         break;
     case Qt::Key_PageUp:
-        setValueLo(mValueLo + mSizePageStep);
-        setValueHi(mValueLo + mSizePageStep);
+        setValues(mValueLo + mSizePageStep, mValueHi + mSizePageStep);
         break;
     case Qt::Key_PageDown:
-        setValueLo(mValueLo - mSizePageStep);
-        setValueHi(mValueLo - mSizePageStep);
+        setValues(mValueLo - mSizePageStep, mValueHi - mSizePageStep);
         break;
     default:
         return QWidget::keyPressEvent(e);
@@ -243,8 +535,8 @@ void RangeSlider::initStyleOption(QStyleOptionSlider *option) const
     option->subControls = QStyle::SC_None;
     option->activeSubControls = QStyle::SC_None;
     option->orientation = orientation();
-    option->maximum = mMaximum;
-    option->minimum = mMinimum;
+    option->maximum = mVisualMaximum;
+    option->minimum = mVisualMinimum;
     option->tickPosition = QSlider::NoTicks;
     option->tickInterval = 0;
     option->upsideDown = false;
@@ -254,26 +546,81 @@ void RangeSlider::initStyleOption(QStyleOptionSlider *option) const
     if(orientation() == Qt::Horizontal) option->state |= QStyle::State_Horizontal;
 }
 
-int RangeSlider::valueDistanceToPixelDistance(const int valueDistance)
+int RangeSlider::valueDistanceToPixelDistance(const int valueDistance) const
 {
-    const int pixelDistance = rect().width() * ((float)valueDistance / (mMaximum - mMinimum));
+    const int pixelDistance = sliderGeometry().toWidth(mVisualMinimum + valueDistance);
     return pixelDistance;
 }
 
+void RangeSlider::drawHistogram(QPainter* p)
+{
+    // one bar per two pixels of the distance the handles' centers can travel
+    const SliderGeometry& g = sliderGeometry();
+    const int left = g.handleSize.width() / 2;
+    const int span = qMax(1, g.pixels);
+    const int bins = qMax(1, span / 2);
+
+    // resampling is cheap, but not free. Only redo it when the window or the data changed.
+    if(mHistogramBins.size() != bins
+            || mHistogramBinsMinimum != mVisualMinimum
+            || mHistogramBinsMaximum != mVisualMaximum
+            || mHistogramBinsGeneration != mHistogram->generation())
+    {
+        mHistogramBins = mHistogram->resample(mVisualMinimum, mVisualMaximum, bins);
+        mHistogramBinsMinimum = mVisualMinimum;
+        mHistogramBinsMaximum = mVisualMaximum;
+        mHistogramBinsGeneration = mHistogram->generation();
+
+        mHistogramPeak = 0;
+        for(int i=0;i<mHistogramBins.size();i++)
+            mHistogramPeak = qMax(mHistogramPeak, mHistogramBins[i]);
+    }
+
+    if(mHistogramPeak <= 0) return;
+
+    const qreal binWidth = (qreal)span / bins;
+    const qreal bottom = height();
+
+    QPolygonF polygon;
+    polygon.reserve(bins * 2 + 2);
+    polygon << QPointF(left, bottom);
+    for(int i=0;i<bins;i++)
+    {
+        const qreal top = bottom - bottom * mHistogramBins[i] / mHistogramPeak;
+        polygon << QPointF(left + i * binWidth, top) << QPointF(left + (i + 1) * binWidth, top);
+    }
+    polygon << QPointF(left + span, bottom);
+
+    QColor color = palette().color(QPalette::Highlight);
+    color.setAlpha(96);
+
+    p->save();
+    p->setPen(Qt::NoPen);
+    p->setBrush(color);
+    p->drawPolygon(polygon);
+    p->restore();
+}
+
 void RangeSlider::paintEvent(QPaintEvent *e)
 {
-    Q_UNUSED(e);
+    WidgetStats::Scope scope(this, "paint", WidgetStats::Scope::Paint);
+
+    // after a handle move, only a few pixels around it are exposed
+    const QRect exposed = e->rect();
+    const bool horizontal = mOrientation == Qt::Horizontal;
 
     QPainter p(this);
     p.setRenderHint(QPainter::Antialiasing, true);
 
-    QStyleOptionSlider opt;
-    initStyleOption(&opt);
+    QStyleOptionSlider opt(sliderGeometry().option);
 
     // draw whole-length groove using default palette
     opt.subControls = QStyle::SC_SliderGroove;
     style()->drawComplexControl(QStyle::CC_Slider, &opt, &p, this);
 
+    // the data's distribution goes under the range
+    if(mHistogram && mHistogram->isReady()) drawHistogram(&p);
+
     // draw rectangle between sliders - this gets fucked up for negative minima!
     opt.sliderPosition = 100;
     opt.sliderValue = 100;
@@ -282,23 +629,30 @@ void RangeSlider::paintEvent(QPaintEvent *e)
     opt.direction = Qt::RightToLeft;
 
     // buggy: when moving the left side, we get strange graphics for negative values. Yes, please send a patch!
-    opt.rect.setLeft(opt.rect.left() + valueDistanceToPixelDistance(mValueLo - mMinimum));
-    opt.rect.setRight(opt.rect.right() - valueDistanceToPixelDistance(mMaximum - mValueHi));
-    style()->drawComplexControl(QStyle::CC_Slider, &opt, &p, this);
+    opt.rect.setLeft(opt.rect.left() + valueDistanceToPixelDistance(mDrawnValueLo - mVisualMinimum));
+    opt.rect.setRight(opt.rect.right() - valueDistanceToPixelDistance(mVisualMaximum - mDrawnValueHi));
+    if(!horizontal || opt.rect.adjusted(-2, 0, 2, 0).intersects(exposed))
+        style()->drawComplexControl(QStyle::CC_Slider, &opt, &p, this);
 
     // Now draw handles
-    initStyleOption(&opt);
+    opt = sliderGeometry().option;
     opt.subControls = QStyle::SC_SliderHandle;
 
     // Left handle
-    opt.sliderPosition = mValueLo;
-    opt.sliderValue = mValueLo;
-    style()->drawComplexControl(QStyle::CC_Slider, &opt, &p, this);
+    if(!horizontal || handleRect(mDrawnValueLo).intersects(exposed))
+    {
+        opt.sliderPosition = mDrawnValueLo;
+        opt.sliderValue = mDrawnValueLo;
+        style()->drawComplexControl(QStyle::CC_Slider, &opt, &p, this);
+    }
 
     // Right handle
-    opt.sliderPosition = mValueHi;
-    opt.sliderValue = mValueHi;
-    style()->drawComplexControl(QStyle::CC_Slider, &opt, &p, this);
+    if(!horizontal || handleRect(mDrawnValueHi).intersects(exposed))
+    {
+        opt.sliderPosition = mDrawnValueHi;
+        opt.sliderValue = mDrawnValueHi;
+        style()->drawComplexControl(QStyle::CC_Slider, &opt, &p, this);
+    }
 
 //    p.setPen(QPen(Qt::green));
 //    p.drawRect(rectContainingBothSliders());
@@ -329,112 +683,248 @@ FloatingRangeSlider::FloatingRangeSlider(const int initialRangeMin, const int in
     RangeSlider(initialRangeMin, initialRangeMax, valueLo, valueHi),
 //    mInitialRangeMin(initialRangeMin),
 //    mInitialRangeMax(initialRangeMax),
-    mPadding(qBound(0.0f, padding, 0.2f))
+    mPadding(qBound(0.0f, padding, 0.2f)),
+    mAnimating(false),
+    mAnimationStart(0),
+    mAnimationFromMinimum(0),
+    mAnimationFromMaximum(0),
+    mAnimationToMinimum(0),
+    mAnimationToMaximum(0),
+    mEasing(QEasingCurve::OutQuart)
+{
+}
+
+FloatingRangeSlider::~FloatingRangeSlider()
 {
-    mPropertyAnimationMin = new QPropertyAnimation(this, "minimum");
-    mPropertyAnimationMin->setDuration(200);
-    mPropertyAnimationMin->setEasingCurve(QEasingCurve::OutQuart);
+    if(mAnimating) RangeAnimationDriver::instance()->remove(this);
+}
+
+void FloatingRangeSlider::animateRange(const int minimum, const int maximum)
+{
+    // The committed range jumps to the target when the animation settles, until then only the
+    // visual range moves. Retargeting starts from wherever the slider is drawn right now.
+    mAnimationFromMinimum = mVisualMinimum;
+    mAnimationFromMaximum = mVisualMaximum;
+    mAnimationToMinimum = minimum;
+    mAnimationToMaximum = maximum;
+
+    RangeAnimationDriver* driver = RangeAnimationDriver::instance();
+    mAnimationStart = driver->now();
+    if(!mAnimating)
+    {
+        mAnimating = true;
+        driver->add(this);
+    }
+}
+
+bool FloatingRangeSlider::stepAnimation(const qint64 now)
+{
+    WidgetStats::Scope scope(this, "animationTick", WidgetStats::Scope::Animation);
+
+    const qreal progress = qMin((qreal)1, (qreal)(now - mAnimationStart) / AnimationDuration);
+    if(progress >= 1)
+    {
+        settleAnimation();
+        return false;
+    }
 
-    mPropertyAnimationMax = new QPropertyAnimation(this, "maximum");
-    mPropertyAnimationMax->setDuration(200);
-    mPropertyAnimationMin->setEasingCurve(QEasingCurve::OutQuart);
+    const qreal eased = mEasing.valueForProgress(progress);
+    setVisualRange(
+                boundedToInt(mAnimationFromMinimum + qRound64(((qint64)mAnimationToMinimum - mAnimationFromMinimum) * eased)),
+                boundedToInt(mAnimationFromMaximum + qRound64(((qint64)mAnimationToMaximum - mAnimationFromMaximum) * eased)));
+    update();
+    return true;
+}
+
+void FloatingRangeSlider::settleAnimation()
+{
+    if(!mAnimating) return;
+
+    // before setRange(), a listener might start the next animation
+    mAnimating = false;
+    RangeAnimationDriver::instance()->remove(this);
+    setRange(mAnimationToMinimum, mAnimationToMaximum);
+
+    // setRange() didn't repaint if the committed range was already the target
+    setVisualRange(mMinimum, mMaximum);
+    update();
+}
+
+void FloatingRangeSlider::mousePressEvent(QMouseEvent* e)
+{
+    // dragging maps pixels through the committed range, so let the slider catch up first
+    settleAnimation();
+    RangeSlider::mousePressEvent(e);
 }
 
 void FloatingRangeSlider::mouseReleaseEvent(QMouseEvent* e)
 {
-    const int currentRange = mMaximum - mMinimum;
+    // decide on the newest values, with the pending moves applied
+    flushDrag();
+
+    // in 64 bit, the range of an int slider doesn't fit in int
+    const qint64 currentRange = (qint64)mMaximum - mMinimum;
+    const qint64 step = currentRange / 5;
+
+    int minimum = mMinimum, maximum = mMaximum;
 
     // If we're close to the minimum, decrease minimum!
-    const float relativePositionLo = (float)(mValueLo - mMinimum) / (mMaximum - mMinimum);
+    const float relativePositionLo = (double)((qint64)mValueLo - mMinimum) / currentRange;
     if(relativePositionLo < mPadding)
-    {
-        qDebug() << "FloatingRangeSlider::mouseReleaseEvent(): starting animation at relativepos" << relativePositionLo;
-        mPropertyAnimationMin->setStartValue(mMinimum);
-        mPropertyAnimationMin->setEndValue(mMinimum - (currentRange * 0.2f));
-        mPropertyAnimationMin->start();
-    }
+        minimum = boundedToInt(mMinimum - step);
     else if(relativePositionLo > 0.5f - mPadding)
-    {
-        qDebug() << "FloatingRangeSlider::mouseReleaseEvent(): starting animation at relativepos" << relativePositionLo;
-        mPropertyAnimationMin->setStartValue(mMinimum);
-        mPropertyAnimationMin->setEndValue(mMinimum + (currentRange * 0.2f));
-        mPropertyAnimationMin->start();
-    }
+        minimum = boundedToInt(mMinimum + step);
 
-    const float relativePositionHi = (float)(mValueHi - mMinimum) / (mMaximum - mMinimum);
+    const float relativePositionHi = (double)((qint64)mValueHi - mMinimum) / currentRange;
     if(relativePositionHi > (1.0f - mPadding))
-    {
-        qDebug() << "FloatingRangeSlider::mouseReleaseEvent(): starting animation at relativepos" << relativePositionHi;
-        mPropertyAnimationMax->setStartValue(mMaximum);
-        mPropertyAnimationMax->setEndValue(mMaximum + (currentRange * 0.2));
-        mPropertyAnimationMax->start();
-    }
+        maximum = boundedToInt(mMaximum + step);
     else if(relativePositionHi < (0.5 + mPadding))
+        maximum = boundedToInt(mMaximum - step);
+
+    if(minimum != mMinimum || maximum != mMaximum)
     {
-        qDebug() << "FloatingRangeSlider::mouseReleaseEvent(): starting animation at relativepos" << relativePositionHi;
-        mPropertyAnimationMax->setStartValue(mMaximum);
-        mPropertyAnimationMax->setEndValue(mMaximum - (currentRange * 0.2));
-        mPropertyAnimationMax->start();
+        qCDebug(lcRangeSliders) << "FloatingRangeSlider: handles at" << relativePositionLo << relativePositionHi << "rescaling to" << minimum << maximum;
+        animateRange(minimum, maximum);
     }
 
     RangeSlider::mouseReleaseEvent(e);
 }
 
+FloatingGradientRangeSlider::FloatingGradientRangeSlider(const int initialRangeMin, const int initialRangeMax, const int valueLo, const int valueHi, const float padding) :
+    FloatingRangeSlider(initialRangeMin, initialRangeMax, valueLo, valueHi, padding),
+    mColorMapVersion(0)
+{
 
+}
 
+bool FloatingGradientRangeSlider::LayerKey::operator==(const LayerKey& o) const
+{
+    return size == o.size
+            && devicePixelRatio == o.devicePixelRatio
+            && style == o.style
+            && paletteKey == o.paletteKey
+            && state == o.state
+            && colorMapVersion == o.colorMapVersion
+            && minimum == o.minimum
+            && maximum == o.maximum
+            && valueLo == o.valueLo
+            && valueHi == o.valueHi;
+}
 
+FloatingGradientRangeSlider::LayerKey FloatingGradientRangeSlider::layerKey(const QStyleOptionSlider& opt) const
+{
+    LayerKey key;
+    key.size = size();
+    key.devicePixelRatio = devicePixelRatioF();
+    key.style = style();
+    key.paletteKey = palette().cacheKey();
+    key.state = opt.state;
+    key.colorMapVersion = mColorMapVersion;
+    key.minimum = mVisualMinimum;
+    key.maximum = mVisualMaximum;
+    key.valueLo = mDrawnValueLo;
+    key.valueHi = mDrawnValueHi;
+    return key;
+}
 
+QRegion FloatingGradientRangeSlider::valuesChangedRegion(const int oldLo, const int oldHi) const
+{
+    if(mOrientation != Qt::Horizontal) return rect();
 
+    // the gradient is stretched between the handles, moving one of them redraws all of it
+    const QRect before = handleRect(oldLo) | handleRect(oldHi);
+    const QRect after = handleRect(mDrawnValueLo) | handleRect(mDrawnValueHi);
+    return (before | after).adjusted(-2, 0, 2, 0);
+}
 
+QPixmap FloatingGradientRangeSlider::createLayerPixmap(const LayerKey& key) const
+{
+    QPixmap pixmap(key.size * key.devicePixelRatio);
+    pixmap.setDevicePixelRatio(key.devicePixelRatio);
+    pixmap.fill(Qt::transparent);
+    return pixmap;
+}
 
+void FloatingGradientRangeSlider::renderBackgroundLayer(const QStyleOptionSlider& opt, const LayerKey& key)
+{
+    QStyleOptionSlider optGroove(opt);
+    optGroove.subControls = QStyle::SC_SliderGroove;
 
+    mBackgroundGroove = createLayerPixmap(key);
+    QPainter p(&mBackgroundGroove);
+    p.setRenderHint(QPainter::Antialiasing, true);
+    style()->drawComplexControl(QStyle::CC_Slider, &optGroove, &p, this);
+    p.end();
 
+    mGrooveRect = style()->subControlRect(QStyle::CC_Slider, &opt, QStyle::SC_SliderGroove, this).adjusted(0, 1, 0, -1);
 
+    // The strip holds the gradient from 0 to 1 at the groove's full (device pixel) width, so
+    // stretching it between the handles never loses resolution. Sliders showing the same gradient
+    // at the same width share it through the rasterizer's cache.
+    mBackgroundGradient = GradientRasterizer::image(mColorMap, QSize(qMax(1, mGrooveRect.width()), 1), key.devicePixelRatio);
 
-FloatingGradientRangeSlider::FloatingGradientRangeSlider(const int initialRangeMin, const int initialRangeMax, const int valueLo, const int valueHi, const float padding) :
-    FloatingRangeSlider(initialRangeMin, initialRangeMax, valueLo, valueHi, padding)
+    mBackgroundKey = key;
+}
+
+void FloatingGradientRangeSlider::renderHandleLayer(const QStyleOptionSlider& opt, const LayerKey& key)
 {
+    QStyleOptionSlider optHandle(opt);
+    optHandle.subControls = QStyle::SC_SliderHandle;
 
-}
+    mHandles = createLayerPixmap(key);
+    QPainter p(&mHandles);
+    p.setRenderHint(QPainter::Antialiasing, true);
+
+    // Left handle
+    optHandle.sliderPosition = mDrawnValueLo;
+    optHandle.sliderValue = mDrawnValueLo;
+    style()->drawComplexControl(QStyle::CC_Slider, &optHandle, &p, this);
+
+    // Right handle
+    optHandle.sliderPosition = mDrawnValueHi;
+    optHandle.sliderValue = mDrawnValueHi;
+    style()->drawComplexControl(QStyle::CC_Slider, &optHandle, &p, this);
 
+    mHandlesKey = key;
+}
 
 void FloatingGradientRangeSlider::paintEvent(QPaintEvent *e)
 {
     Q_UNUSED(e);
+    WidgetStats::Scope scope(this, "paint", WidgetStats::Scope::Paint);
 
-    QPainter p(this);
-    p.setRenderHint(QPainter::Antialiasing, true);
+    const QStyleOptionSlider& opt = sliderGeometry().option;
 
-    QStyleOptionSlider opt;
-    initStyleOption(&opt);
+    LayerKey key = layerKey(opt);
 
-    // draw whole-length groove using default palette
-    opt.subControls = QStyle::SC_SliderGroove;
-    style()->drawComplexControl(QStyle::CC_Slider, &opt, &p, this);
+    // the background doesn't care about the handles
+    LayerKey keyBackground = key;
+    keyBackground.minimum = keyBackground.maximum = 0;
+    keyBackground.valueLo = keyBackground.valueHi = 0;
+    WidgetStats::count(this, keyBackground == mBackgroundKey ? WidgetStats::CacheHits : WidgetStats::CacheMisses);
+    if(keyBackground != mBackgroundKey) renderBackgroundLayer(opt, keyBackground);
 
-    QLinearGradient gradient(rectContainingBothSliders().topLeft(), rectContainingBothSliders().topRight());
-    gradient.setSpread(QGradient::PadSpread);
+    // ... and the handles don't care about the gradient
+    LayerKey keyHandles = key;
+    keyHandles.colorMapVersion = 0;
+    WidgetStats::count(this, keyHandles == mHandlesKey ? WidgetStats::CacheHits : WidgetStats::CacheMisses);
+    if(keyHandles != mHandlesKey) renderHandleLayer(opt, keyHandles);
 
-    QMapIterator<float, QColor> i(mColorMap);
-    while(i.hasNext()){
-        i.next();
-        gradient.setColorAt(i.key(), i.value());
+    QPainter p(this);
+    p.drawPixmap(0, 0, mBackgroundGroove);
+
+    // Stretch the gradient between the handles and pad it with its outer colors, like a
+    // QLinearGradient with PadSpread would do.
+    const QRect rectBetweenHandles = rectContainingBothSliders();
+    const QRect rectGradient(rectBetweenHandles.left(), mGrooveRect.top(), rectBetweenHandles.width(), mGrooveRect.height());
+    p.setClipRect(mGrooveRect);
+    if(!mColorMap.isEmpty())
+    {
+        p.fillRect(QRect(QPoint(mGrooveRect.left(), mGrooveRect.top()), QPoint(rectGradient.left() - 1, mGrooveRect.bottom())), mColorMap.first());
+        p.fillRect(QRect(QPoint(rectGradient.right() + 1, mGrooveRect.top()), mGrooveRect.bottomRight()), mColorMap.last());
     }
+    p.drawImage(rectGradient, mBackgroundGradient);
+    p.setClipping(false);
 
-    const QRect groove = style()->subControlRect(QStyle::CC_Slider, &opt, QStyle::SC_SliderGroove, this);
-    p.fillRect(groove.adjusted(0, 1, 0, -1), QBrush(gradient));
-
-    // Now draw handles
-    initStyleOption(&opt);
-    opt.subControls = QStyle::SC_SliderHandle;
-
-    // Left handle
-    opt.sliderPosition = mValueLo;
-    opt.sliderValue = mValueLo;
-    style()->drawComplexControl(QStyle::CC_Slider, &opt, &p, this);
-
-    // Right handle
-    opt.sliderPosition = mValueHi;
-    opt.sliderValue = mValueHi;
-    style()->drawComplexControl(QStyle::CC_Slider, &opt, &p, this);
+    p.drawPixmap(0, 0, mHandles);
 }
@@ -5,10 +5,21 @@
 #include <QPainter>
 #include <QDebug>
 #include <QPalette>
-#include <QPropertyAnimation>
+#include <QEasingCurve>
+#include <QPixmap>
+#include <QImage>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QSharedPointer>
 
 #include <QStyleOption>
 
+#include "rangemodel.h"
+#include "rangecore.h"
+
+class RangeHistogram;
+
 // Warning: only works for horizontal sliders. Vertical must be completed.
 
 class RangeSlider : public QWidget
@@ -27,6 +38,15 @@ public:
         MoveLo
     };
 
+    // How mouse moves turn into values while dragging. With a 1000 Hz mouse, ImmediateDrag does
+    // all the work (setters, signals, repaint) a thousand times per second.
+    enum DragMode
+    {
+        ImmediateDrag, // every move event sets the values
+        CompressedDrag, // queued moves are collapsed, the newest one sets the values once per event loop iteration
+        PredictedDrag // like CompressedDrag, the handles are drawn ahead by the cursor's velocity for one frame
+    };
+
     RangeSlider(const int rangeMin, const int rangeMax, const int valueLo, const int valueHi);
     Qt::Orientation orientation() const { return mOrientation; }
     void setOrientation(const Qt::Orientation orientation);
@@ -34,6 +54,20 @@ public:
     const int maximum() const {return mMaximum;}
     const int valueLo() const { return mValueLo; }
     const int valueHi() const { return mValueHi; }
+    int commitInterval() const { return mCommitTimer->interval(); }
+
+    // Whatever the mode, the values (and so the signals and the model) are the ones under the cursor
+    DragMode dragMode() const { return mDragMode; }
+    void setDragMode(const DragMode mode) { mDragMode = mode; }
+
+    // The values for other threads. Hold on to the pointer as long as you like, it stays valid
+    // after the slider is gone (and then simply stops changing).
+    QSharedPointer<const RangeModel> model() const { return mModel; }
+
+    // Draws the histogram's distribution between minimum and maximum under the range. The slider
+    // doesn't take ownership, one histogram can be shared by several sliders.
+    void setHistogram(RangeHistogram* histogram);
+    RangeHistogram* histogram() const { return mHistogram; }
     QSize sizeHint() const;
     QSize minimumSizeHint() const;
 
@@ -41,21 +75,91 @@ public slots:
     void setMinimum(const int min);
     void setMaximum(const int max);
     void setRange(const int min, const int max);
-    void setStepSize(const int f) {mSizeSingleStep = f;}
-    void setPageSize(const int f) {mSizePageStep = f;}
+    void setStepSize(const int f) {mSizeSingleStep = f; invalidateSliderGeometry();}
+    void setPageSize(const int f) {mSizePageStep = f; invalidateSliderGeometry();}
     void setValueLo(int valueLo);
     void setValueHi(int valueHi);
+    void setValues(int valueLo, int valueHi);
+
+    // rangeCommitted() is emitted at most once per interval, 0 means once per event loop iteration
+    void setCommitInterval(const int msec) { mCommitTimer->setInterval(msec); }
 
 signals:
     void valueLoChanged(int valueLo);
     void valueHiChanged(int valueHi);
     void rangeChanged(int lo, int hi);
 
+    // Coalesced: fires after the values settled for this event loop iteration (or commit interval),
+    // and only if they differ from what was committed last time.
+    void rangeCommitted(int valueLo, int valueHi);
+
+    // Fires once when a mouse drag that changed the values ends.
+    void rangeFinished(int valueLo, int valueHi);
+
+private slots:
+    void slotCommit();
+    void slotApplyDrag();
+
 protected:
+    // Everything painting, hit testing and dragging need from the range, the size and the style.
+    // Rebuilt lazily after a resize, style, palette, focus, hover, screen or orientation change, and
+    // the scales after a range change. The mappings are RangeValueTraits<int>'s with the RangeScales
+    // cached, so the steady state does no divisions and no QStyle queries.
+    struct SliderGeometry
+    {
+        SliderGeometry() : valid(false), minimum(0), maximum(0), width(0), pixels(0), devicePixelRatio(0), logicalDpi(0) { }
+
+        void setRange(const int min, const int max);
+
+        // left edge of a handle at value, in [0, pixels]
+        int toPixel(const int value) const { return RangeValueTraits<int>::toPixel(value, minimum, pixelScale); }
+
+        // same for the whole width, used for the range rectangle
+        int toWidth(const int value) const { return RangeValueTraits<int>::toPixel(value, minimum, widthScale); }
+
+        // value moved by pixelDelta pixels of handle travel, bounded to [minimum, maximum]
+        int movedByPixels(const int value, const int pixelDelta) const
+        {
+            return RangeValueTraits<int>::movedByPixels(value, pixelDelta, minimum, maximum, pixels, valueScale);
+        }
+
+        bool valid;
+        int minimum, maximum;
+        int width; // of the widget
+        int pixels; // how far a handle's left edge can travel
+        qreal devicePixelRatio; // of the screen it was built for
+        int logicalDpi;
+        QSize handleSize;
+        QStyleOptionSlider option; // from initStyleOption()
+
+        RangeScale pixelScale, widthScale, valueScale;
+    };
+
+    const SliderGeometry& sliderGeometry() const;
+    void invalidateSliderGeometry() { mSliderGeometry.valid = false; }
+    void setVisualRange(const int min, const int max);
+
     void initStyleOption(QStyleOptionSlider* option) const;
-    int valueDistanceToPixelDistance(const int valueDistance);
-    QRect rectContainingBothSliders();
+    void scheduleCommit();
+    void publish() { mModel->publish(mMinimum, mMaximum, mValueLo, mValueHi); }
+    int valueDistanceToPixelDistance(const int valueDistance) const;
+    QRect rectContainingBothSliders() const;
+    QRect handleRect(const int value) const; // horizontal only
+
+    // What needs repainting after the drawn values changed from oldLo/oldHi to the current ones
+    virtual QRegion valuesChangedRegion(const int oldLo, const int oldHi) const;
+    void setDrawnValues(const int valueLo, const int valueHi);
+    void drawHistogram(QPainter* p);
 
+    void dragTo(const QPoint& pos, const int extraPixels);
+    void flushDrag(); // before looking at the values at the end of a drag
+
+    void resizeEvent(QResizeEvent*);
+    void changeEvent(QEvent*);
+    void focusInEvent(QFocusEvent*);
+    void focusOutEvent(QFocusEvent*);
+    void enterEvent(QEvent*);
+    void leaveEvent(QEvent*);
     void mouseMoveEvent(QMouseEvent*);
     void mousePressEvent(QMouseEvent*);
     virtual void mouseReleaseEvent(QMouseEvent*);
@@ -63,22 +167,57 @@ protected:
     virtual void paintEvent(QPaintEvent*);
 
     Qt::Orientation mOrientation;
-    QSize mSliderHandleSize; // how many pixels is the slider handle wide/high?
     int mMinimum, mMaximum;
+    int mVisualMinimum, mVisualMaximum; // what is drawn, differs from the above while animating
     int mValueLo, mValueHi;
+    int mDrawnValueLo, mDrawnValueHi; // where the handles are painted, ahead of the values while predicting
     int mSizeSingleStep, mSizePageStep;
     QPoint mDragStartPosition;
     int mDragStartValueLo, mDragStartValueHi;
     MouseMovementMode mMouseMovementMode;
+    QTimer* mCommitTimer;
+    int mCommittedValueLo, mCommittedValueHi;
+
+    DragMode mDragMode;
+    QTimer* mDragTimer;
+    QPoint mDragPosition; // newest cursor position
+    QElapsedTimer mDragClock;
+    qint64 mDragSampleTime; // usecs on mDragClock
+    int mDragSamplePixel;
+    qreal mDragVelocity; // pixels per msec
+
+    QPointer<RangeHistogram> mHistogram;
+    QVector<float> mHistogramBins; // resampled for the current range and width
+    float mHistogramPeak;
+    int mHistogramBinsMinimum, mHistogramBinsMaximum;
+    quint64 mHistogramBinsGeneration;
+
+    QSharedPointer<RangeModel> mModel;
+
+    mutable SliderGeometry mSliderGeometry;
 };
 
 class FloatingRangeSlider : public RangeSlider
 {
     Q_OBJECT
 
+    friend class RangeAnimationDriver;
+
+    enum { AnimationDuration = 200 }; // msec
+
     float mPadding;
-    QPropertyAnimation* mPropertyAnimationMin;
-    QPropertyAnimation* mPropertyAnimationMax;
+
+    // Rescaling, stepped by the shared RangeAnimationDriver. Only the visual range is interpolated,
+    // the committed range changes once when the animation settles.
+    bool mAnimating;
+    qint64 mAnimationStart; // driver clock
+    int mAnimationFromMinimum, mAnimationFromMaximum;
+    int mAnimationToMinimum, mAnimationToMaximum;
+    QEasingCurve mEasing;
+
+    void animateRange(const int minimum, const int maximum);
+    bool stepAnimation(const qint64 now); // false once settled
+    void settleAnimation();
 
 public:
     // Use padding = 0.1 as an example:
@@ -86,8 +225,12 @@ public:
     //  - when lo slider goes higher than (middle-padding)=40%, we rescale the slider
     //  - when hi slider goes lower than (middle+padding)=60%, we rescale the slider
     FloatingRangeSlider(const int initialRangeMin, const int initialRangeMax, const int valueLo, const int valueHi, const float padding);
+    ~FloatingRangeSlider();
+
+    bool isAnimating() const { return mAnimating; }
 
 protected:
+    void mousePressEvent(QMouseEvent*e);
     void mouseReleaseEvent(QMouseEvent*e);
 };
 
@@ -95,7 +238,41 @@ class FloatingGradientRangeSlider : public FloatingRangeSlider
 {
     Q_OBJECT
 
+    // Describes what a cached layer was rendered for. A layer is reused as long as its key matches.
+    struct LayerKey
+    {
+        QSize size;
+        qreal devicePixelRatio;
+        const QStyle* style;
+        qint64 paletteKey;
+        int state;
+        quint64 colorMapVersion;
+        int minimum, maximum;
+        int valueLo, valueHi;
+
+        LayerKey() : devicePixelRatio(0), style(nullptr), paletteKey(0), state(0), colorMapVersion(0), minimum(0), maximum(0), valueLo(0), valueHi(0) { }
+        bool operator==(const LayerKey& o) const;
+        bool operator!=(const LayerKey& o) const { return !(*this == o); }
+    };
+
     QMap<float, QColor> mColorMap;
+    quint64 mColorMapVersion;
+
+    // Background layer: the groove and a strip with the whole gradient. It doesn't depend on the
+    // handles, the strip is stretched between them when compositing.
+    LayerKey mBackgroundKey;
+    QPixmap mBackgroundGroove;
+    QImage mBackgroundGradient;
+    QRect mGrooveRect;
+
+    // Handle layer: both handles on a transparent pixmap, depends on the handles only.
+    LayerKey mHandlesKey;
+    QPixmap mHandles;
+
+    LayerKey layerKey(const QStyleOptionSlider& opt) const;
+    QPixmap createLayerPixmap(const LayerKey& key) const;
+    void renderBackgroundLayer(const QStyleOptionSlider& opt, const LayerKey& key);
+    void renderHandleLayer(const QStyleOptionSlider& opt, const LayerKey& key);
 
 public:
     FloatingGradientRangeSlider(const int initialRangeMin, const int initialRangeMax, const int valueLo, const int valueHi, const float padding);
@@ -104,10 +281,12 @@ public slots:
     void slotSetColorMap(const QMap<float, QColor>& colorMap)
     {
         mColorMap = colorMap;
+        mColorMapVersion++;
         update();
     }
 
 protected:
+    QRegion valuesChangedRegion(const int oldLo, const int oldHi) const;
     void paintEvent(QPaintEvent*);
 };
 
@@ -0,0 +1,309 @@
+#include "rangesliderpanel.h"
+#include "rangecore.h"
+#include "widgetstats.h"
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QStyleOption>
+
+namespace
+{
+    typedef RangeValueTraits<int> IntTraits;
+}
+
+bool RangeSliderPanel::PixmapKey::operator==(const PixmapKey& o) const
+{
+    return width == o.width
+            && rowHeight == o.rowHeight
+            && devicePixelRatio == o.devicePixelRatio
+            && style == o.style
+            && paletteKey == o.paletteKey;
+}
+
+RangeSliderPanel::RangeSliderPanel(QWidget* parent) :
+    QAbstractScrollArea(parent),
+    mRowHeight(24),
+    mLabelWidth(120),
+    mDragRow(-1),
+    mMouseMovementMode(Disabled),
+    mDragStartValueLo(0),
+    mDragStartValueHi(0)
+{
+    setFocusPolicy(Qt::StrongFocus);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    updateScrollBars();
+}
+
+void RangeSliderPanel::reserve(const int rows)
+{
+    mLabels.reserve(rows);
+    mMinimum.reserve(rows);
+    mMaximum.reserve(rows);
+    mValueLo.reserve(rows);
+    mValueHi.reserve(rows);
+}
+
+int RangeSliderPanel::addRow(const QString& label, const int rangeMin, const int rangeMax, const int valueLo, const int valueHi)
+{
+    const int minimum = qMin(rangeMin, rangeMax);
+    const int maximum = qMax(rangeMin, rangeMax);
+    const int lo = qBound(minimum, valueLo, maximum);
+    const int hi = qBound(minimum, valueHi, maximum);
+
+    mLabels.append(label);
+    mMinimum.append(minimum);
+    mMaximum.append(maximum);
+    mValueLo.append(qMin(lo, hi));
+    mValueHi.append(qMax(lo, hi));
+
+    updateScrollBars();
+    viewport()->update(rowRect(rowCount() - 1));
+    return rowCount() - 1;
+}
+
+void RangeSliderPanel::clear()
+{
+    mLabels.clear();
+    mMinimum.clear();
+    mMaximum.clear();
+    mValueLo.clear();
+    mValueHi.clear();
+    mDragRow = -1;
+    mMouseMovementMode = Disabled;
+
+    updateScrollBars();
+    viewport()->update();
+}
+
+void RangeSliderPanel::setRowHeight(const int height)
+{
+    mRowHeight = qMax(1, height);
+    updateScrollBars();
+    viewport()->update();
+}
+
+void RangeSliderPanel::setLabelWidth(const int width)
+{
+    mLabelWidth = qMax(0, width);
+    viewport()->update();
+}
+
+void RangeSliderPanel::setValues(const int row, int valueLo, int valueHi)
+{
+    if(row < 0 || row >= rowCount()) return;
+
+    valueLo = qBound(mMinimum[row], valueLo, mMaximum[row]);
+    valueHi = qBound(mMinimum[row], valueHi, mMaximum[row]);
+    if(valueLo > valueHi) qSwap(valueLo, valueHi);
+    if(valueLo == mValueLo[row] && valueHi == mValueHi[row]) return;
+
+    mValueLo[row] = valueLo;
+    mValueHi[row] = valueHi;
+
+    emit valuesChanged(row, valueLo, valueHi);
+    viewport()->update(rowRect(row));
+}
+
+void RangeSliderPanel::setRange(const int row, const int min, const int max)
+{
+    if(row < 0 || row >= rowCount()) return;
+
+    const int minimum = qMin(min, max);
+    const int maximum = qMax(min, max);
+    if(minimum == mMinimum[row] && maximum == mMaximum[row]) return;
+
+    mMinimum[row] = minimum;
+    mMaximum[row] = maximum;
+    setValues(row, mValueLo[row], mValueHi[row]); // re-bound
+
+    emit rangeChanged(row, minimum, maximum);
+    viewport()->update(rowRect(row));
+}
+
+int RangeSliderPanel::rowAt(const QPoint& pos) const
+{
+    if(pos.y() < 0) return -1;
+    const int row = (pos.y() + verticalScrollBar()->value()) / mRowHeight;
+    return row < rowCount() ? row : -1;
+}
+
+QRect RangeSliderPanel::rowRect(const int row) const
+{
+    return QRect(0, row * mRowHeight - verticalScrollBar()->value(), viewport()->width(), mRowHeight);
+}
+
+int RangeSliderPanel::sliderWidth() const
+{
+    return qMax(1, viewport()->width() - mLabelWidth);
+}
+
+int RangeSliderPanel::handlePixel(const int row, const int value) const
+{
+    const int pixels = qMax(1, sliderWidth() - mHandleSize.width());
+    return IntTraits::toPixel(value, mMinimum[row], mMaximum[row], pixels);
+}
+
+void RangeSliderPanel::updatePixmaps()
+{
+    PixmapKey key;
+    key.width = sliderWidth();
+    key.rowHeight = mRowHeight;
+    key.devicePixelRatio = viewport()->devicePixelRatioF();
+    key.style = style();
+    key.paletteKey = palette().cacheKey();
+    if(key == mPixmapKey) return;
+    mPixmapKey = key;
+
+    QStyleOptionSlider opt;
+    opt.initFrom(this);
+    opt.rect = QRect(0, 0, key.width, key.rowHeight);
+    opt.subControls = QStyle::SC_SliderGroove;
+    opt.activeSubControls = QStyle::SC_None;
+    opt.orientation = Qt::Horizontal;
+    opt.state |= QStyle::State_Horizontal;
+    opt.tickPosition = QSlider::NoTicks;
+    opt.tickInterval = 0;
+    opt.upsideDown = false;
+    opt.direction = Qt::LeftToRight;
+    opt.minimum = 0;
+    opt.maximum = 0;
+    opt.sliderPosition = 0;
+    opt.sliderValue = 0;
+
+    mHandleSize = style()->subControlRect(QStyle::CC_Slider, &opt, QStyle::SC_SliderHandle, this).size();
+    mGrooveRect = style()->subControlRect(QStyle::CC_Slider, &opt, QStyle::SC_SliderGroove, this);
+
+    mGroove = QPixmap(opt.rect.size() * key.devicePixelRatio);
+    mGroove.setDevicePixelRatio(key.devicePixelRatio);
+    mGroove.fill(Qt::transparent);
+    QPainter p(&mGroove);
+    p.setRenderHint(QPainter::Antialiasing, true);
+    style()->drawComplexControl(QStyle::CC_Slider, &opt, &p, this);
+    p.end();
+
+    // one handle, blitted twice per row
+    opt.rect = QRect(0, 0, mHandleSize.width(), key.rowHeight);
+    opt.subControls = QStyle::SC_SliderHandle;
+    mHandle = QPixmap(opt.rect.size() * key.devicePixelRatio);
+    mHandle.setDevicePixelRatio(key.devicePixelRatio);
+    mHandle.fill(Qt::transparent);
+    p.begin(&mHandle);
+    p.setRenderHint(QPainter::Antialiasing, true);
+    style()->drawComplexControl(QStyle::CC_Slider, &opt, &p, this);
+    p.end();
+}
+
+void RangeSliderPanel::updateScrollBars()
+{
+    const int contentHeight = rowCount() * mRowHeight;
+    verticalScrollBar()->setRange(0, qMax(0, contentHeight - viewport()->height()));
+    verticalScrollBar()->setPageStep(viewport()->height());
+    verticalScrollBar()->setSingleStep(mRowHeight);
+}
+
+void RangeSliderPanel::resizeEvent(QResizeEvent* e)
+{
+    QAbstractScrollArea::resizeEvent(e);
+    updateScrollBars();
+}
+
+void RangeSliderPanel::scrollContentsBy(int dx, int dy)
+{
+    // move what's already painted, only the newly exposed strip gets a paintEvent()
+    viewport()->scroll(dx, dy);
+}
+
+void RangeSliderPanel::mousePressEvent(QMouseEvent* e)
+{
+    const int row = rowAt(e->pos());
+    if(row == -1) return;
+
+    updatePixmaps(); // for the handle size
+
+    const int x = e->pos().x() - mLabelWidth;
+    const int left = handlePixel(row, mValueLo[row]);
+    const int length = handlePixel(row, mValueHi[row]) + mHandleSize.width() - left;
+    const int pixelsIntoRectBetweenHandles = x - left;
+
+    if(pixelsIntoRectBetweenHandles < 0 || pixelsIntoRectBetweenHandles > length)
+        return;
+
+    mDragRow = row;
+    mDragStartPosition = e->pos();
+    mDragStartValueLo = mValueLo[row];
+    mDragStartValueHi = mValueHi[row];
+
+    if(pixelsIntoRectBetweenHandles < mHandleSize.width())
+        mMouseMovementMode = MoveLo;
+    else if(pixelsIntoRectBetweenHandles >= length - mHandleSize.width())
+        mMouseMovementMode = MoveHi;
+    else
+        mMouseMovementMode = MoveBoth;
+}
+
+void RangeSliderPanel::mouseMoveEvent(QMouseEvent* e)
+{
+    if(!e->buttons() || mMouseMovementMode == Disabled || mDragRow >= rowCount()) return;
+
+    const int row = mDragRow;
+    const int pixelDelta = e->pos().x() - mDragStartPosition.x();
+    const int pixels = qMax(1, sliderWidth() - mHandleSize.width());
+
+    switch(mMouseMovementMode)
+    {
+    case MoveBoth:
+        setValues(row,
+                  IntTraits::movedByPixels(mDragStartValueLo, pixelDelta, mMinimum[row], mMaximum[row], pixels),
+                  IntTraits::movedByPixels(mDragStartValueHi, pixelDelta, mMinimum[row], mMaximum[row], pixels));
+        break;
+    case MoveHi:
+        setValues(row, mValueLo[row], IntTraits::movedByPixels(mDragStartValueHi, pixelDelta, mMinimum[row], mMaximum[row], pixels));
+        break;
+    case MoveLo:
+        setValues(row, IntTraits::movedByPixels(mDragStartValueLo, pixelDelta, mMinimum[row], mMaximum[row], pixels), mValueHi[row]);
+        break;
+    default:
+        break;
+    }
+}
+
+void RangeSliderPanel::mouseReleaseEvent(QMouseEvent*)
+{
+    mDragRow = -1;
+    mMouseMovementMode = Disabled;
+}
+
+void RangeSliderPanel::paintEvent(QPaintEvent* e)
+{
+    WidgetStats::Scope scope(this, "paint", WidgetStats::Scope::Paint);
+
+    updatePixmaps();
+
+    QPainter p(viewport());
+
+    // only the rows intersecting the exposed rect
+    const QRect exposed = e->rect();
+    const int offset = verticalScrollBar()->value();
+    const int first = qMax(0, (exposed.top() + offset) / mRowHeight);
+    const int last = qMin(rowCount() - 1, (exposed.bottom() + offset) / mRowHeight);
+
+    const QColor colorRange = palette().color(QPalette::Highlight);
+    const int halfHandle = mHandleSize.width() / 2;
+    p.setPen(palette().color(QPalette::Text));
+
+    for(int row=first;row<=last;row++)
+    {
+        const QRect rect = rowRect(row);
+        p.drawText(QRect(rect.left() + 4, rect.top(), mLabelWidth - 8, rect.height()), Qt::AlignVCenter | Qt::AlignLeft, mLabels[row]);
+
+        const QPoint origin(rect.left() + mLabelWidth, rect.top());
+        const int pixelLo = handlePixel(row, mValueLo[row]);
+        const int pixelHi = handlePixel(row, mValueHi[row]);
+
+        p.drawPixmap(origin, mGroove);
+        p.fillRect(QRect(origin.x() + pixelLo + halfHandle, origin.y() + mGrooveRect.top(), pixelHi - pixelLo, mGrooveRect.height()), colorRange);
+        p.drawPixmap(origin + QPoint(pixelLo, 0), mHandle);
+        p.drawPixmap(origin + QPoint(pixelHi, 0), mHandle);
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef RANGESLIDERPANEL_H
+#define RANGESLIDERPANEL_H
+
+#include <QAbstractScrollArea>
+#include <QVector>
+#include <QStringList>
+#include <QPixmap>
+
+class QStyle;
+
+// Hundreds of labelled range sliders (e.g. one per column of a table) in one scrollable widget.
+// Rows aren't widgets: their state lives in flat per-field arrays, and a single paintEvent() draws
+// only the visible rows from a cached groove and a cached handle pixmap.
+class RangeSliderPanel : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    explicit RangeSliderPanel(QWidget* parent = nullptr);
+
+    void reserve(const int rows);
+    int addRow(const QString& label, const int rangeMin, const int rangeMax, const int valueLo, const int valueHi);
+    void clear();
+
+    int rowCount() const { return mLabels.size(); }
+    QString label(const int row) const { return mLabels.at(row); }
+    int minimum(const int row) const { return mMinimum.at(row); }
+    int maximum(const int row) const { return mMaximum.at(row); }
+    int valueLo(const int row) const { return mValueLo.at(row); }
+    int valueHi(const int row) const { return mValueHi.at(row); }
+
+    int rowHeight() const { return mRowHeight; }
+    void setRowHeight(const int height);
+    int labelWidth() const { return mLabelWidth; }
+    void setLabelWidth(const int width);
+
+    // row at pos in viewport coordinates, or -1
+    int rowAt(const QPoint& pos) const;
+
+public slots:
+    void setValues(const int row, int valueLo, int valueHi);
+    void setRange(const int row, const int min, const int max);
+
+signals:
+    void valuesChanged(int row, int valueLo, int valueHi);
+    void rangeChanged(int row, int min, int max);
+
+protected:
+    enum MouseMovementMode
+    {
+        Disabled,
+        MoveBoth,
+        MoveHi,
+        MoveLo
+    };
+
+    // What the cached pixmaps were rendered for
+    struct PixmapKey
+    {
+        PixmapKey() : width(0), rowHeight(0), devicePixelRatio(0), style(nullptr), paletteKey(0) { }
+        bool operator==(const PixmapKey& o) const;
+        bool operator!=(const PixmapKey& o) const { return !(*this == o); }
+
+        int width, rowHeight;
+        qreal devicePixelRatio;
+        const QStyle* style;
+        qint64 paletteKey;
+    };
+
+    QRect rowRect(const int row) const; // viewport coordinates
+    int sliderWidth() const;
+    int handlePixel(const int row, const int value) const; // left edge, relative to the slider
+    void updatePixmaps();
+    void updateScrollBars();
+
+    void resizeEvent(QResizeEvent*);
+    void scrollContentsBy(int dx, int dy);
+    void mousePressEvent(QMouseEvent*);
+    void mouseMoveEvent(QMouseEvent*);
+    void mouseReleaseEvent(QMouseEvent*);
+    void paintEvent(QPaintEvent*);
+
+    // one entry per row
+    QStringList mLabels;
+    QVector<int> mMinimum, mMaximum;
+    QVector<int> mValueLo, mValueHi;
+
+    int mRowHeight;
+    int mLabelWidth;
+
+    PixmapKey mPixmapKey;
+    QPixmap mGroove;
+    QPixmap mHandle;
+    QRect mGrooveRect; // relative to a row's slider area
+    QSize mHandleSize;
+
+    int mDragRow;
+    MouseMovementMode mMouseMovementMode;
+    QPoint mDragStartPosition;
+    int mDragStartValueLo, mDragStartValueHi;
+};
+
+#endif // RANGESLIDERPANEL_H
@@ -0,0 +1,35 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Helpers for the SSE2/AVX2 kernels. SSE2 is used whenever the compiler targets it (always on x86-64).
+// With gcc/clang the AVX2 kernels are compiled with a per-function target attribute and picked at
+// runtime, so a build without -mavx2 still uses them on CPUs that support it.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RANGESLIDERS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(RANGESLIDERS_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define RANGESLIDERS_AVX2
+#define RANGESLIDERS_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(__AVX2__)
+#define RANGESLIDERS_AVX2
+#define RANGESLIDERS_TARGET_AVX2
+#include <immintrin.h>
+#endif
+
+inline bool simdHasAvx2()
+{
+#if defined(RANGESLIDERS_AVX2) && defined(__AVX2__)
+    return true;
+#elif defined(RANGESLIDERS_AVX2)
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2;
+#else
+    return false;
+#endif
+}
+
+#endif // SIMD_H
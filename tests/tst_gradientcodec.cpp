@@ -0,0 +1,208 @@
+// Round trips through GradientCodec's text, binary and list formats, and what happens with
+// truncated and corrupt input.
+
+#include <QtTest>
+#include <QtEndian>
+
+#include <math.h>
+#include <string.h>
+
+#include "gradientcodec.h"
+
+namespace
+{
+    QMap<float, QColor> sampleGradient()
+    {
+        QMap<float, QColor> stops;
+        stops.insert(0.0f, QColor(0, 0, 255));
+        stops.insert(0.125f, QColor(0, 255, 255, 128));
+        stops.insert(0.333333f, QColor(1, 2, 3));
+        stops.insert(0.5f, QColor(255, 255, 0, 0));
+        stops.insert(1.0f, QColor(255, 0, 0));
+        return stops;
+    }
+
+    QMap<float, QColor> manyStops(const int count)
+    {
+        QMap<float, QColor> stops;
+        for(int i=0;i<count;i++)
+            stops.insert((float)i / count, QColor(i % 256, (i / 256) % 256, 0));
+        return stops;
+    }
+}
+
+class TestGradientCodec : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void textRoundTrip()
+    {
+        const QMap<float, QColor> stops = sampleGradient();
+        const QString text = GradientCodec::toText(stops);
+        QCOMPARE(GradientCodec::fromText(text), stops);
+        QCOMPARE(GradientCodec::fromText(text.toLatin1()), stops);
+    }
+
+    void textOpaqueStopsHaveNoAlpha()
+    {
+        QMap<float, QColor> stops;
+        stops.insert(0.0f, QColor(1, 2, 3));
+        stops.insert(1.0f, QColor(4, 5, 6));
+        QCOMPARE(GradientCodec::toText(stops), QString("0,1,2,3:1,4,5,6"));
+    }
+
+    void textKeepsStopsOneFloatStepApart()
+    {
+        // a hard edge as GradientImporter writes it
+        QMap<float, QColor> stops;
+        stops.insert(0.0f, QColor(0, 0, 0));
+        stops.insert(0.5f, QColor(255, 0, 0));
+        stops.insert(nextafterf(0.5f, 1.0f), QColor(0, 0, 255));
+        stops.insert(1.0f, QColor(255, 255, 255));
+        QCOMPARE(GradientCodec::fromText(GradientCodec::toText(stops)), stops);
+
+        // short positions stay short
+        QVERIFY(GradientCodec::toText(stops).startsWith("0,0,0,0:0.5,255,0,0:"));
+    }
+
+    void textSkipsMalformedStops()
+    {
+        const QByteArray text("0,1,2,3::garbage:0.5,1,2:1,255,255,255,");
+        QMap<float, QColor> stops;
+        QVERIFY(!GradientCodec::parseText(text.constData(), text.size(), stops));
+        QCOMPARE(stops.size(), 1);
+        QCOMPARE(stops.value(0.0f), QColor(1, 2, 3));
+    }
+
+    void textBoundsHugeNumbers()
+    {
+        const QByteArray text("0,1e20,-1e20,300,1e300:1e999,0,0,0:0.5,0e999,-0e999,0e-999,0e999:1,0,0,0");
+        QMap<float, QColor> stops;
+        QVERIFY(!GradientCodec::parseText(text.constData(), text.size(), stops));
+        QCOMPARE(stops.size(), 3);
+        QCOMPARE(stops.value(0.0f), QColor(255, 0, 255, 255));
+        QCOMPARE(stops.value(0.5f), QColor(0, 0, 0, 0));
+        QVERIFY(stops.contains(1.0f));
+
+        // zero times a huge power of ten is zero, not NaN
+        const QByteArray zero("0e999,1,2,3");
+        stops.clear();
+        QVERIFY(GradientCodec::parseText(zero.constData(), zero.size(), stops));
+        QCOMPARE(stops.size(), 1);
+        QCOMPARE(stops.value(0.0f), QColor(1, 2, 3));
+
+        int i = 0;
+        double value = 1.0;
+        QVERIFY(GradientCodec::readNumber("0.000e999", 9, i, value));
+        QCOMPARE(i, 9);
+        QCOMPARE(value, 0.0);
+    }
+
+    void binaryRoundTrip()
+    {
+        const QMap<float, QColor> stops = sampleGradient();
+        const QByteArray binary = GradientCodec::toBinary(stops);
+
+        QMap<float, QColor> decoded;
+        QCOMPARE(GradientCodec::fromBinary(binary.constData(), binary.size(), decoded), binary.size());
+        QCOMPARE(decoded, stops);
+    }
+
+    void binaryTruncated()
+    {
+        const QByteArray binary = GradientCodec::toBinary(sampleGradient());
+        for(int size=0;size<binary.size();size++)
+        {
+            QMap<float, QColor> decoded;
+            QCOMPARE(GradientCodec::fromBinary(binary.constData(), size, decoded), 0);
+            QVERIFY(decoded.isEmpty());
+        }
+    }
+
+    void binaryRejectsUnknownVersion()
+    {
+        QByteArray binary = GradientCodec::toBinary(sampleGradient());
+        binary[0] = (char)(GradientCodec::BinaryVersion + 1);
+        QVERIFY(GradientCodec::fromBinary(binary).isEmpty());
+    }
+
+    void binaryRejectsNonFinitePositions()
+    {
+        const quint32 patterns[] = {0x7FC00000u, 0xFFC00001u, 0x7F800000u, 0xFF800000u}; // NaNs, infinities
+        for(int i=0;i<4;i++)
+        {
+            QByteArray binary = GradientCodec::toBinary(sampleGradient());
+            uchar position[4];
+            qToLittleEndian<quint32>(patterns[i], position);
+            memcpy(binary.data() + 3 + 8 * 2, position, sizeof(position)); // third stop
+
+            QMap<float, QColor> decoded;
+            QCOMPARE(GradientCodec::fromBinary(binary.constData(), binary.size(), decoded), 0);
+            QVERIFY(decoded.isEmpty());
+        }
+    }
+
+    void binaryTooManyStops()
+    {
+        QVERIFY(!GradientCodec::toBinary(manyStops(GradientCodec::MaximumStops)).isEmpty());
+        QVERIFY(GradientCodec::toBinary(manyStops(GradientCodec::MaximumStops + 1)).isEmpty());
+
+        QByteArray out("prefix");
+        QVERIFY(!GradientCodec::appendBinary(manyStops(GradientCodec::MaximumStops + 1), out));
+        QCOMPARE(out, QByteArray("prefix"));
+    }
+
+    void listRoundTrip()
+    {
+        QVector<QMap<float, QColor> > gradients;
+        gradients.append(sampleGradient());
+        gradients.append(QMap<float, QColor>());
+        gradients.append(manyStops(300));
+
+        QVector<QMap<float, QColor> > decoded;
+        QVERIFY(GradientCodec::decodeList(GradientCodec::encodeList(gradients), decoded));
+        QCOMPARE(decoded, gradients);
+    }
+
+    void listTruncated()
+    {
+        QVector<QMap<float, QColor> > gradients;
+        gradients.append(sampleGradient());
+        gradients.append(sampleGradient());
+        const QByteArray list = GradientCodec::encodeList(gradients);
+
+        for(int size=0;size<list.size();size++)
+        {
+            QVector<QMap<float, QColor> > decoded;
+            QVERIFY(!GradientCodec::decodeList(list.left(size), decoded));
+            QVERIFY(decoded.isEmpty());
+        }
+    }
+
+    void listCorrupt()
+    {
+        QVector<QMap<float, QColor> > gradients;
+        gradients.append(sampleGradient());
+        const QByteArray list = GradientCodec::encodeList(gradients);
+        QVector<QMap<float, QColor> > decoded;
+
+        QByteArray badMagic = list;
+        badMagic[0] = 'X';
+        QVERIFY(!GradientCodec::decodeList(badMagic, decoded));
+
+        // a count the data can't hold
+        QByteArray badCount = list;
+        badCount[8] = (char)0x7F;
+        QVERIFY(!GradientCodec::decodeList(badCount, decoded));
+        QVERIFY(decoded.isEmpty());
+
+        QVector<QMap<float, QColor> > tooLarge;
+        tooLarge.append(manyStops(GradientCodec::MaximumStops + 1));
+        QVERIFY(GradientCodec::encodeList(tooLarge).isEmpty());
+    }
+};
+
+QTEST_APPLESS_MAIN(TestGradientCodec)
+
+#include "tst_gradientcodec.moc"
@@ -4,13 +4,40 @@
 #include <QDebug>
 #include <QColor>
 #include <QMouseEvent>
+
+#include "gradientrasterizer.h"
+#include "gradientcodec.h"
+#include "gradientlibrary.h"
+#include "widgetstats.h"
 #include <QColorDialog>
 
+#include <algorithm>
+#include <limits>
+
+#include <math.h>
+
+namespace
+{
+    bool positionLess(const GradientMarker& marker, const float position) { return marker.position < position; }
+    bool lessPosition(const float position, const GradientMarker& marker) { return position < marker.position; }
+}
+
 WidgetGradientEditor::WidgetGradientEditor(QWidget *parent)
     : QWidget(parent),
       mPadding(0.1),
-      mSpreadMode(QGradient::PadSpread)
+      mSpreadMode(QGradient::PadSpread),
+      mVersion(0),
+      mFocusedMarker(-1)
 {
+    qRegisterMetaType<GradientChange>();
+    qRegisterMetaType<GradientSnapshot>();
+    qRegisterMetaType<QVector<GradientChange> >();
+
+    mChangeTimer = new QTimer(this);
+    mChangeTimer->setSingleShot(true);
+    mChangeTimer->setInterval(16);
+    connect(mChangeTimer, &QTimer::timeout, this, &WidgetGradientEditor::slotFlushChanges);
+
     setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Minimum);
     setToolTip("");
     setFocusPolicy(Qt::StrongFocus);
@@ -23,119 +50,224 @@ WidgetGradientEditor::WidgetGradientEditor(QWidget *parent)
 
 const QMap<float, QColor> WidgetGradientEditor::getGradient() const
 {
-    QMap<float, QColor> gradientStops;
-    for(int i=0;i<mMarkers.size();i++)
-        gradientStops.insert(mMarkers[i].position, mMarkers[i].color);
-    return gradientStops;
+    return snapshot().stops;
 }
 
-void WidgetGradientEditor::setGradient(const QMap<float, QColor> stops)
+const GradientSnapshot& WidgetGradientEditor::snapshot() const
 {
-    if(stops.size() < 2)
-    {
-        slotReset();
-        return;
-    }
-
-    mMarkers.clear();
-    QMapIterator<float, QColor> i(stops);
-    while (i.hasNext())
+    if(mSnapshot.version != mVersion)
     {
-        i.next();
-        mMarkers.append(GradientMarker(i.key(), i.value()));
+        // the markers are sorted, appending with an end() hint is linear instead of n log n
+        QMap<float, QColor> gradientStops;
+        for(int i=0;i<mMarkers.size();i++)
+            gradientStops.insert(gradientStops.constEnd(), mMarkers[i].position, mMarkers[i].color);
+        mSnapshot.stops = gradientStops;
+        mSnapshot.version = mVersion;
     }
+    return mSnapshot;
 }
 
-const QString WidgetGradientEditor::gradientToString(const QMap<float, QColor> stops)
+void WidgetGradientEditor::notifyChanged(const GradientChange& change, const bool immediately)
 {
-    QString config;
-    QMapIterator<float, QColor> i(stops);
-    while (i.hasNext())
+    mVersion++;
+
+    // A drag produces a move per mouse event, consumers only need to know where it went overall
+    if(change.type == GradientChange::MarkerMoved && !mPendingChanges.isEmpty())
     {
-        i.next();
-        config.append(
-                    QString("%1%2,%3,%4,%5")
-                    .arg(i.hasPrevious() ? ":":"")
-                    .arg(i.key())
-                    .arg(i.value().red())
-                    .arg(i.value().green())
-                    .arg(i.value().blue()));
+        GradientChange& last = mPendingChanges.last();
+        if(last.type == GradientChange::MarkerMoved && last.index == change.index)
+        {
+            last.newPosition = change.newPosition;
+            WidgetStats::count(this, WidgetStats::Coalesced);
+            if(immediately) slotFlushChanges();
+            return;
+        }
     }
-    return config;
+
+    mPendingChanges.append(change);
+
+    if(immediately)
+        slotFlushChanges();
+    else if(!mChangeTimer->isActive())
+        mChangeTimer->start();
+    else
+        WidgetStats::count(this, WidgetStats::Coalesced);
 }
 
-QMap<float, QColor> WidgetGradientEditor::stringToGradient(const QString config)
+void WidgetGradientEditor::slotFlushChanges()
 {
-    QMap<float, QColor> gradientStops;
-    const QStringList stops = config.split(":", QString::SkipEmptyParts);
+    mChangeTimer->stop();
+    if(mPendingChanges.isEmpty()) return;
 
-    for(int i=0;i<stops.size();i++)
+    const QVector<GradientChange> changes = mPendingChanges;
+    mPendingChanges.clear();
+
+    WidgetStats::emitted(this, "gradientEdited");
+    emit gradientEdited(snapshot(), changes);
+    WidgetStats::emitted(this, "gradientChanged");
+    emit gradientChanged(snapshot().stops);
+}
+
+void WidgetGradientEditor::setGradient(const QMap<float, QColor> stops)
+{
+    if(stops.size() < 2)
     {
-        const QStringList props = stops.at(i).split(",");
-        if(props.size() == 4) gradientStops.insert(props.at(0).toFloat(), QColor(props.at(1).toInt(), props.at(2).toInt(), props.at(3).toInt()));
+        slotReset();
+        return;
     }
 
-    return gradientStops;
+    resetMarkers(stops);
 }
 
-void WidgetGradientEditor::slotReset(const Preset &preset)
+const QString WidgetGradientEditor::gradientToString(const QMap<float, QColor> stops)
 {
-    mMarkerIsReadyToMove = false;
-    mMarkerHasBeenMoved = false;
-    mMarkers.clear();
+    return GradientCodec::toText(stops);
+}
+
+QMap<float, QColor> WidgetGradientEditor::stringToGradient(const QString config)
+{
+    return GradientCodec::fromText(config);
+}
 
-    // do not emit a changed signal for every single marker!
-    blockSignals(true);
+QMap<float, QColor> WidgetGradientEditor::presetGradient(const Preset preset)
+{
+    QMap<float, QColor> stops;
 
     if(preset == PresetJet)
     {
-        slotAddMarker(QColor(255,000,000), 1.00);
-        slotAddMarker(QColor(255,255,000), 0.75);
-        slotAddMarker(QColor(000,255,000), 0.50);
-        slotAddMarker(QColor(000,255,255), 0.25);
-        slotAddMarker(QColor(000,000,255), 0.00);
+        stops.insert(0.00, QColor(000,000,255));
+        stops.insert(0.25, QColor(000,255,255));
+        stops.insert(0.50, QColor(000,255,000));
+        stops.insert(0.75, QColor(255,255,000));
+        stops.insert(1.00, QColor(255,000,000));
     }
     else if(preset == PresetJetDark)
     {
-        slotAddMarker(QColor(255,128,000), 0.75);
-        slotAddMarker(QColor(255,000,000), 1.00);
-        slotAddMarker(QColor(000,128,255), 0.25);
-        slotAddMarker(QColor(000,128,000), 0.50);
-        slotAddMarker(QColor(000,000,255), 0.00);
+        stops.insert(0.00, QColor(000,000,255));
+        stops.insert(0.25, QColor(000,128,255));
+        stops.insert(0.50, QColor(000,128,000));
+        stops.insert(0.75, QColor(255,128,000));
+        stops.insert(1.00, QColor(255,000,000));
     }
     else if(preset == PresetEarth)
     {
-        slotAddMarker(QColor(000,128,255), 0.25);
-        slotAddMarker(QColor(000,128,000), 0.50);
+        stops.insert(0.25, QColor(000,128,255));
+        stops.insert(0.50, QColor(000,128,000));
     }
 
-    blockSignals(false);
-    emit gradientChanged(getGradient());
+    return stops;
+}
+
+void WidgetGradientEditor::slotReset(const Preset &preset)
+{
+    resetMarkers(presetGradient(preset));
+}
+
+bool WidgetGradientEditor::loadPreset(const GradientLibrary& library, const quint32 id)
+{
+    const int index = library.indexOfId(id);
+    if(index == -1) return false;
+
+    resetMarkers(library.stops(index));
+    return true;
+}
+
+void WidgetGradientEditor::resetMarkers(const QMap<float, QColor>& stops)
+{
+    mMarkerIsReadyToMove = false;
+    mMarkerHasBeenMoved = false;
+
+    // all markers at once, one changed signal for the whole reset. The map is sorted already.
+    mMarkers.clear();
+    mMarkers.reserve(stops.size());
+    mFocusedMarker = -1;
+    QMapIterator<float, QColor> i(stops);
+    while(i.hasNext())
+    {
+        i.next();
+        mMarkers.append(GradientMarker(i.key(), i.value()));
+    }
+
+    mPendingChanges.clear();
+    notifyChanged(GradientChange());
     update();
 }
 
 void WidgetGradientEditor::slotAddMarker(const QColor &color, float position, const bool isMovedByMouse)
 {
+    // Two markers at one position would be a single stop in the gradient. Step off an occupied
+    // position to the right, and if that runs into 1, to the left instead. Never outside [0, 1].
+    const auto occupied = [this](const float p)
+    {
+        const QVector<GradientMarker>::const_iterator it = std::lower_bound(mMarkers.constBegin(), mMarkers.constEnd(), p, positionLess);
+        return it != mMarkers.constEnd() && it->position == p;
+    };
+
+    position = qBound(0.0f, position, 1.0f);
+    const float requested = position;
+    while(occupied(position) && position < 1.0f)
+        position = nextafterf(position, 1.0f);
+
+    if(occupied(position))
+    {
+        position = requested;
+        while(occupied(position) && position > 0.0f)
+            position = nextafterf(position, 0.0f);
+    }
+
     GradientMarker marker;
     marker.color = color;
     marker.position = position;
 
+    const int index = std::upper_bound(mMarkers.constBegin(), mMarkers.constEnd(), position, lessPosition) - mMarkers.constBegin();
+    mMarkers.insert(index, marker);
+    if(mFocusedMarker >= index) mFocusedMarker++;
+
     if(isMovedByMouse)
     {
-        marker.hasFocus = true;
+        setFocusedMarker(index);
         mMarkerIsReadyToMove = true;
+        qCDebug(lcRangeSliders) << "addMarker: marker" << index << "has focus";
+    }
 
-        // clear all other marker's focus!
-        for(int i=0;i<mMarkers.size();i++)
+    update();
+    notifyChanged(GradientChange(GradientChange::MarkerAdded, index, position, position, color, color));
+}
+
+void WidgetGradientEditor::setFocusedMarker(const int index)
+{
+    if(mFocusedMarker >= 0 && mFocusedMarker < mMarkers.size()) mMarkers[mFocusedMarker].hasFocus = false;
+    mFocusedMarker = index;
+    if(mFocusedMarker >= 0) mMarkers[mFocusedMarker].hasFocus = true;
+}
+
+int WidgetGradientEditor::markerPixel(const float position) const
+{
+    return mRectGradient.left() + position * mRectGradient.width();
+}
+
+float WidgetGradientEditor::pixelPosition(const int pixel) const
+{
+    return mRectGradient.width() > 0 ? (float)(pixel - mRectGradient.left()) / mRectGradient.width() : 0.0f;
+}
+
+int WidgetGradientEditor::markerAt(const int x) const
+{
+    // markers are sorted, only those within reach of x need a look
+    const QVector<GradientMarker>::const_iterator first = std::lower_bound(mMarkers.constBegin(), mMarkers.constEnd(), pixelPosition(x - 9), positionLess);
+    const QVector<GradientMarker>::const_iterator last = std::upper_bound(first, mMarkers.constEnd(), pixelPosition(x + 9), lessPosition);
+
+    int index = -1, distance = 9;
+    for(QVector<GradientMarker>::const_iterator it=first;it!=last;++it)
+    {
+        const int d = qAbs(x - markerPixel(it->position));
+        if(d < distance)
         {
-            Q_ASSERT(!mMarkers[i].hasFocus);
-            mMarkers[i].hasFocus = false;
-            qDebug() << "addMarker: marker" << i << "has focus:" << mMarkers[i].hasFocus;
+            distance = d;
+            index = it - mMarkers.constBegin();
         }
     }
-
-    mMarkers.append(marker);
-    emit gradientChanged(getGradient());
+    return index;
 }
 
 void WidgetGradientEditor::removeMarker(int index)
@@ -144,13 +276,18 @@ void WidgetGradientEditor::removeMarker(int index)
     {
         return;
     }
+    const GradientMarker marker = mMarkers.at(index);
     mMarkers.removeAt(index);
+    if(mFocusedMarker == index) mFocusedMarker = -1;
+    else if(mFocusedMarker > index) mFocusedMarker--;
     update();
-    emit gradientChanged(getGradient());
+    notifyChanged(GradientChange(GradientChange::MarkerRemoved, index, marker.position, marker.position, marker.color, marker.color));
 }
 
-void WidgetGradientEditor::paintEvent(QPaintEvent *)
+void WidgetGradientEditor::paintEvent(QPaintEvent *e)
 {
+    WidgetStats::Scope scope(this, "paint", WidgetStats::Scope::Paint);
+
     if(mRectView.size().isNull()  || mRectView.size().isEmpty() || mRectView.topLeft() == mRectView.bottomRight())
     {
         mRectView = QRect(QPoint(0,0), QPoint(width(), height()));
@@ -164,39 +301,49 @@ void WidgetGradientEditor::paintEvent(QPaintEvent *)
     painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
     painter.setRenderHint(QPainter::Antialiasing);
 
-    QPoint gradStart = QPoint(mRectGradient.topLeft ().x(), mRectGradient.bottomLeft ().y()/2);
-    QPoint gradStop  = QPoint(mRectGradient.topRight().x(), mRectGradient.bottomRight().y()/2);
-    QLinearGradient gradient(gradStart, gradStop);
-    gradient.setSpread(mSpreadMode);
+    // The gradient spans mRectGradient and is padded with its outer colors, like a QLinearGradient
+    // with PadSpread. The strip comes from the rasterizer's cache, so it's only rendered when the
+    // markers or the width changed.
+    const QRect rectFill = mRectView.adjusted(0, 1, 0, -12); // 12 px bottom padding - leave room for sliders!
+    const QMap<float, QColor>& stops = snapshot().stops;
+    const QImage strip = GradientRasterizer::image(stops, QSize(qMax(1, mRectGradient.width()), 1), devicePixelRatioF());
+    painter.fillRect(QRect(QPoint(rectFill.left(), rectFill.top()), QPoint(mRectGradient.left() - 1, rectFill.bottom())), stops.isEmpty() ? QColor(Qt::black) : stops.first());
+    painter.fillRect(QRect(QPoint(mRectGradient.right() + 1, rectFill.top()), rectFill.bottomRight()), stops.isEmpty() ? QColor(Qt::white) : stops.last());
+    painter.drawImage(QRect(mRectGradient.left(), rectFill.top(), mRectGradient.width(), rectFill.height()), strip);
 
-    for(int i=0;i<mMarkers.size();i++)
-    {
-        const GradientMarker& marker = mMarkers.at(i);
-        gradient.setColorAt(marker.position, marker.color);
-    }
-
-    painter.fillRect(mRectView.adjusted(0, 1, 0, -12), QBrush(gradient)); // 12 px bottom padding - leave room for sliders!
     painter.setPen(QPen(palette().color(QPalette::WindowText)));
     painter.drawLine(mRectGradient.topLeft(), mRectGradient.bottomLeft());
     painter.drawLine(mRectGradient.topRight(), mRectGradient.bottomRight());
 
+    // Only markers reaching into the exposed rect, and of those landing on the same pixel only the
+    // first. When they're closer than a marker is wide (e.g. a 4096 stop palette), each one is
+    // just a line in its color.
+    const QRect exposed = e->rect();
+    const QVector<GradientMarker>::const_iterator first = std::lower_bound(mMarkers.constBegin(), mMarkers.constEnd(), pixelPosition(exposed.left() - 4), positionLess);
+    const QVector<GradientMarker>::const_iterator last = std::upper_bound(first, mMarkers.constEnd(), pixelPosition(exposed.right() + 4), lessPosition);
+    const bool dense = mRectGradient.width() < 8 * mMarkers.size();
+
     painter.setPen(QPen(palette().color(QPalette::WindowText)));
     QPen pen;
-    pen.setWidth(3);
-    for(int i=0;i<mMarkers.size();i++)
+    pen.setWidth(dense ? 1 : 3);
+    painter.setRenderHint(QPainter::Antialiasing, !dense);
+    int previousPixel = std::numeric_limits<int>::min();
+    for(QVector<GradientMarker>::const_iterator it=first;it!=last;++it)
     {
-        /*painter.drawPie(
-                    QRect(
-                        mRectGradient.left() + mMarkers[i].position*mRectGradient.width() - 8,
-                        height()-17,
-                        16, 16),
-                    -45*16, // start angle * 16
-                    -90*16); // span angle * 16*/
-        pen.setColor(mMarkers[i].color);
+        const int pixel = markerPixel(it->position);
+        if(pixel == previousPixel && it - mMarkers.constBegin() != mFocusedMarker) continue;
+        previousPixel = pixel;
+
+        pen.setColor(it->color);
         painter.setPen(pen);
-        painter.drawEllipse(QRect(mRectGradient.left() + mMarkers[i].position*mRectGradient.width() - 2, height()-7, 4, 4));
+        if(dense)
+        {
+            painter.drawLine(pixel, height() - 9, pixel, height() - 1);
+            continue;
+        }
+        painter.drawEllipse(QRect(pixel - 2, height()-7, 4, 4));
         painter.setPen(QPen(palette().color(QPalette::WindowText)));
-        painter.drawEllipse(QRect(mRectGradient.left() + mMarkers[i].position*mRectGradient.width() - 4, height()-9, 8, 8));
+        painter.drawEllipse(QRect(pixel - 4, height()-9, 8, 8));
     }
 
     painter.end();
@@ -211,30 +358,22 @@ void WidgetGradientEditor::resizeEvent(QResizeEvent * event)
 void WidgetGradientEditor::mousePressEvent(QMouseEvent *event)
 {
     dragStart = event->pos();
-    //qDebug() << "viewrect:" << viewRect;
-    for(int i=0;i<mMarkers.size();i++)
+
+    const int index = markerAt(dragStart.x());
+    setFocusedMarker(-1);
+    if(index != -1)
     {
-        GradientMarker& marker = mMarkers[i];//it.value();
-        const int pixelPosOfMarker = mRectGradient.left() + marker.position * mRectGradient.width();
-        if(abs(dragStart.x() - pixelPosOfMarker) < 9)
+        if(event->button() == Qt::LeftButton)
         {
-            if(event->button() == Qt::LeftButton)
-            {
-                marker.hasFocus = true;
-                mMarkerIsReadyToMove = true;
-                mMarkerHasBeenMoved = false;
-            }
-            else
-            {
-                removeMarker(i);
-                update();
-                emit gradientChanged(getGradient());
-                return;
-            }
+            setFocusedMarker(index);
+            mMarkerIsReadyToMove = true;
+            mMarkerHasBeenMoved = false;
         }
         else
         {
-            marker.hasFocus = false;
+            removeMarker(index);
+            update();
+            return;
         }
     }
 
@@ -242,7 +381,7 @@ void WidgetGradientEditor::mousePressEvent(QMouseEvent *event)
     {
         // We did not find a marker whose poly covers the clicked point, so the user doesn't want to move a marker. Add a marker here!
         const float  markerPos = (float)(event->pos().x() - mRectGradient.left())/(mRectGradient.width() - 5);
-        qDebug() << "adding marker at" << markerPos;
+        qCDebug(lcRangeSliders) << "adding marker at" << markerPos;
         //mMarkerIsReadyToMove = true;
 
         QColor colorSelected = QColorDialog::getColor(QColor(((float)qrand())/RAND_MAX*255, (float)qrand()/RAND_MAX*255, (float)qrand()/RAND_MAX*255), this, "Select step color");
@@ -255,61 +394,64 @@ void WidgetGradientEditor::mousePressEvent(QMouseEvent *event)
 
 void WidgetGradientEditor::mouseMoveEvent(QMouseEvent *event)
 {
-    if(!mMarkerIsReadyToMove) return;
+    if(!mMarkerIsReadyToMove || mFocusedMarker == -1) return;
 
-    for(int i=0;i<mMarkers.size();i++)
-    {
-        GradientMarker& marker = mMarkers[i];
-        if(marker.hasFocus)
-        {
-            const int pixelPosOfMarker = mRectGradient.left() + marker.position * mRectGradient.width();
-            const float dPos = (float)(event->pos().x() - dragStart.x())/((qreal)mRectGradient.width());
+    const int i = mFocusedMarker;
+    GradientMarker& marker = mMarkers[i];
+    const int pixelPosOfMarker = markerPixel(marker.position);
+    const float dPos = (float)(event->pos().x() - dragStart.x())/((qreal)mRectGradient.width());
 
-            // We always set this true. If the user wants to drag a slider at 0.0 to the left or at 1.0 to the right, it won't work.
-            // But we shouldn't show a color-dialog after releasing the mouse!
-            mMarkerHasBeenMoved = true;
+    // We always set this true. If the user wants to drag a slider at 0.0 to the left or at 1.0 to the right, it won't work.
+    // But we shouldn't show a color-dialog after releasing the mouse!
+    mMarkerHasBeenMoved = true;
 
-            if(marker.position + dPos > 1 || marker.position + dPos < 0) break; // do not move beyond borders
-            if(dPos > 0 && event->pos().x() < pixelPosOfMarker) break; // sync mouse cursor with slider before moving
-            if(dPos < 0 && event->pos().x() > pixelPosOfMarker) break; // sync mouse cursor with slider before moving
+    // Markers stay sorted, so one can't pass its neighbours (like MultiRangeSlider's handles), and
+    // stops one float step short of them: on a neighbour's position both would be one stop.
+    const float lowest = i > 0 ? nextafterf(mMarkers[i - 1].position, 1.0f) : 0.0f;
+    const float highest = i < mMarkers.size() - 1 ? nextafterf(mMarkers[i + 1].position, 0.0f) : 1.0f;
 
-            marker.position += dPos;
-            emit gradientChanged(getGradient());
-            break;
+    const bool beyondBorders = marker.position + dPos > 1 || marker.position + dPos < 0; // do not move beyond borders
+    const bool cursorBehind = (dPos > 0 && event->pos().x() < pixelPosOfMarker) || (dPos < 0 && event->pos().x() > pixelPosOfMarker); // sync mouse cursor with slider before moving
+    if(!beyondBorders && !cursorBehind)
+    {
+        const float oldPosition = marker.position;
+        marker.position = qBound(lowest, marker.position + dPos, highest);
+        if(marker.position != oldPosition)
+        {
+            // only the gradient between the neighbours changes, plus the marker itself
+            update(QRect(QPoint(markerPixel(lowest) - 5, 0), QPoint(markerPixel(highest) + 5, height())));
+            notifyChanged(GradientChange(GradientChange::MarkerMoved, i, oldPosition, marker.position, marker.color, marker.color), false);
         }
     }
     dragStart = event->pos();
-    update();
 }
 
 void WidgetGradientEditor::mouseReleaseEvent(QMouseEvent *)
 {
     mMarkerIsReadyToMove = false;
 
+    // the drag is over, don't keep consumers waiting for the timer
+    slotFlushChanges();
+
     if(mMarkerHasBeenMoved)
     {
         // make sure that marker doesn't completely overlap with neighbors!
     }
     else
     {
-        GradientMarker& marker = mMarkers[0];
-        int index = -1;
-        for(int i=0;i<mMarkers.size();i++)
-        {
-            if(mMarkers[i].hasFocus) index = i;
-        }
-
+        const int index = mFocusedMarker;
         if(index != -1)
         {
             // A marker was clicked/released without being moved. Change color!
-            QColor newColor = QColorDialog::getColor(marker.color, this, "Select step color");
+            QColor newColor = QColorDialog::getColor(mMarkers[index].color, this, "Select step color");
             if(newColor.isValid())
             {
-                qDebug() << "marker 1" << marker.color;
+                qCDebug(lcRangeSliders) << "marker 1" << mMarkers[index].color;
+                const QColor oldColor = mMarkers[index].color;
                 mMarkers[index].color = newColor;
-                qDebug() << "marker 2" << mMarkers[index].color;
+                qCDebug(lcRangeSliders) << "marker 2" << mMarkers[index].color;
                 update();
-                emit gradientChanged(getGradient());
+                notifyChanged(GradientChange(GradientChange::MarkerRecolored, index, mMarkers[index].position, mMarkers[index].position, oldColor, newColor));
             }
         }
     }
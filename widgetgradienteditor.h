@@ -2,6 +2,13 @@
 #define WIDGETGRADIENTEDITOR_H
 
 #include <QWidget>
+#include <QMap>
+#include <QVector>
+#include <QColor>
+#include <QTimer>
+#include <QMetaType>
+
+class GradientLibrary;
 
 struct GradientMarker
 {
@@ -26,6 +33,42 @@ public:
    QColor color;
 };
 
+// Describes a single edit, so consumers (e.g. GradientLut::applyChanges()) can update in place.
+// index refers to the editor's marker list at the time of the edit.
+struct GradientChange
+{
+    enum Type
+    {
+        MarkerAdded,
+        MarkerRemoved,
+        MarkerMoved,
+        MarkerRecolored,
+        Reset // anything may have changed
+    };
+
+    GradientChange() : type(Reset), index(-1), oldPosition(0), newPosition(0) { }
+
+    GradientChange(const Type type, const int index, const float oldPosition, const float newPosition, const QColor& oldColor, const QColor& newColor) :
+        type(type), index(index), oldPosition(oldPosition), newPosition(newPosition), oldColor(oldColor), newColor(newColor) { }
+
+    Type type;
+    int index;
+    float oldPosition, newPosition;
+    QColor oldColor, newColor;
+};
+
+// The gradient at a given version. Copies are cheap, the stops are implicitly shared.
+struct GradientSnapshot
+{
+    GradientSnapshot() : version(0) { }
+
+    quint64 version;
+    QMap<float, QColor> stops;
+};
+
+Q_DECLARE_METATYPE(GradientChange)
+Q_DECLARE_METATYPE(GradientSnapshot)
+
 class WidgetGradientEditor : public QWidget
 {
    Q_OBJECT
@@ -43,9 +86,19 @@ public:
 
    void removeMarker(int index);
    const QMap<float, QColor> getGradient() const;
+   const GradientSnapshot& snapshot() const;
+   quint64 version() const { return mVersion; }
+
+   // while dragging, change signals are emitted at most once per interval
+   int changeInterval() const { return mChangeTimer->interval(); }
+   void setChangeInterval(const int msec) { mChangeTimer->setInterval(msec); }
    void setGradient(const QMap<float, QColor> stops);
    static const QString gradientToString(const QMap<float, QColor> stops);
    static QMap<float, QColor> stringToGradient(const QString config);
+   static QMap<float, QColor> presetGradient(const Preset preset);
+
+   // replaces the markers with the library's preset, returns false if there is no such id
+   bool loadPreset(const GradientLibrary& library, const quint32 id);
 
 protected:
    void paintEvent       (QPaintEvent *);
@@ -61,7 +114,25 @@ public slots:
 signals:
    void gradientChanged(const QMap<float, QColor>);
 
+   // emitted together with gradientChanged(), lists all changes since the previous emission
+   void gradientEdited(const GradientSnapshot& snapshot, const QVector<GradientChange>& changes);
+
+private slots:
+   void slotFlushChanges();
+
 private:
+   void notifyChanged(const GradientChange& change, const bool immediately = true);
+   void resetMarkers(const QMap<float, QColor>& stops);
+
+   void setFocusedMarker(const int index); // -1 for none
+   int markerPixel(const float position) const;
+   float pixelPosition(const int pixel) const;
+   int markerAt(const int x) const; // nearest marker within reach of x, or -1
+
+   quint64 mVersion;
+   mutable GradientSnapshot mSnapshot; // rebuilt lazily when its version is behind mVersion
+   QVector<GradientChange> mPendingChanges;
+   QTimer* mChangeTimer;
    QGradient::Spread mSpreadMode;
    float mPadding; // the padding area on the outer edges is used to repeat/pad the gradient
    bool mMarkerIsReadyToMove;
@@ -70,7 +141,8 @@ private:
    QRect mRectGradient;
    QSize viewSize;
    QPoint dragStart;
-   QVector<GradientMarker> mMarkers;
+   QVector<GradientMarker> mMarkers; // sorted by position, so hit testing and culling are binary searches
+   int mFocusedMarker; // -1 if none
 };
 
 #endif // WIDGETGRADIENTEDITOR_H
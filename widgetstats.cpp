@@ -0,0 +1,248 @@
+#include "widgetstats.h"
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+// debug output is opt-in, e.g. QT_LOGGING_RULES="rangesliders.debug=true"
+Q_LOGGING_CATEGORY(lcRangeSliders, "rangesliders", QtWarningMsg)
+
+std::atomic<bool> WidgetStats::sEnabled(false);
+std::atomic<bool> WidgetStats::sTracing(false);
+
+namespace
+{
+    struct Event
+    {
+        const char* name;
+        int entry; // becomes the trace's thread id, so each widget gets its own track
+        qint64 timestamp, duration; // microseconds
+        char phase; // 'X' for slices, 'i' for instants
+    };
+
+    struct State
+    {
+        State() : droppedEvents(0) { }
+
+        QMutex mutex;
+        QHash<const void*, int> index; // key -> entry
+        QVector<WidgetStats::Entry> entries; // forgotten ones stay, their events still need a name
+        QVector<Event> events;
+        quint64 droppedEvents;
+    };
+
+    State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    // call with the mutex held
+    int entryFor(State& s, const QObject* object, const char* source)
+    {
+        const void* key = object ? static_cast<const void*>(object) : static_cast<const void*>(source);
+        const QHash<const void*, int>::const_iterator it = s.index.constFind(key);
+        if(it != s.index.constEnd()) return it.value();
+
+        WidgetStats::Entry entry;
+        if(object)
+        {
+            entry.name = QString::fromLatin1(object->metaObject()->className());
+            if(!object->objectName().isEmpty()) entry.name += QLatin1Char(' ') + object->objectName();
+        }
+        else
+        {
+            entry.name = QString::fromLatin1(source ? source : "unknown");
+        }
+
+        s.entries.append(entry);
+        s.index.insert(key, s.entries.size() - 1);
+        return s.entries.size() - 1;
+    }
+
+    // call with the mutex held
+    void appendEvent(State& s, const char* name, const int entry, const qint64 timestamp, const qint64 duration, const char phase)
+    {
+        if(s.events.size() >= WidgetStats::eventLimit())
+        {
+            s.droppedEvents++;
+            return;
+        }
+
+        Event event;
+        event.name = name;
+        event.entry = entry;
+        event.timestamp = timestamp;
+        event.duration = duration;
+        event.phase = phase;
+        s.events.append(event);
+    }
+}
+
+void WidgetStats::setEnabled(const bool enabled)
+{
+    sEnabled.store(enabled, std::memory_order_relaxed);
+    if(!enabled) sTracing.store(false, std::memory_order_relaxed);
+}
+
+void WidgetStats::setTracing(const bool tracing)
+{
+    sTracing.store(tracing, std::memory_order_relaxed);
+    if(tracing) sEnabled.store(true, std::memory_order_relaxed);
+}
+
+quint64 WidgetStats::droppedEvents()
+{
+    State& s = state();
+    QMutexLocker locker(&s.mutex);
+    return s.droppedEvents;
+}
+
+qint64 WidgetStats::now()
+{
+    // QElapsedTimer's reference is the monotonic clock, keep its epoch so traces line up with
+    // other processes' traces
+    struct Clock
+    {
+        Clock() { timer.start(); epoch = timer.msecsSinceReference() * 1000; }
+        QElapsedTimer timer;
+        qint64 epoch;
+    };
+    static const Clock clock;
+    return clock.epoch + clock.timer.nsecsElapsed() / 1000;
+}
+
+void WidgetStats::record(const QObject* object, const char* source, const Counter counter, const quint64 n)
+{
+    State& s = state();
+    QMutexLocker locker(&s.mutex);
+    s.entries[entryFor(s, object, source)].counters.values[counter] += n;
+}
+
+void WidgetStats::recordSignal(const QObject* object, const char* signal)
+{
+    const qint64 timestamp = now();
+
+    State& s = state();
+    QMutexLocker locker(&s.mutex);
+    const int entry = entryFor(s, object, nullptr);
+    s.entries[entry].counters.values[Signals]++;
+    if(isTracing()) appendEvent(s, signal, entry, timestamp, 0, 'i');
+}
+
+void WidgetStats::Scope::finish()
+{
+    const qint64 duration = now() - mStart;
+
+    State& s = state();
+    QMutexLocker locker(&s.mutex);
+    const int entry = entryFor(s, mObject, mObject ? nullptr : mName);
+    Counters& counters = s.entries[entry].counters;
+    if(mKind == Paint)
+    {
+        counters.values[Paints]++;
+        counters.values[PaintMicroseconds] += duration;
+    }
+    else if(mKind == Animation)
+    {
+        counters.values[AnimationTicks]++;
+    }
+    if(isTracing()) appendEvent(s, mName, entry, mStart, duration, 'X');
+}
+
+WidgetStats::Counters WidgetStats::counters(const QObject* object)
+{
+    State& s = state();
+    QMutexLocker locker(&s.mutex);
+    const QHash<const void*, int>::const_iterator it = s.index.constFind(object);
+    return it == s.index.constEnd() ? Counters() : s.entries.at(it.value()).counters;
+}
+
+QVector<WidgetStats::Entry> WidgetStats::entries()
+{
+    State& s = state();
+    QMutexLocker locker(&s.mutex);
+    return s.entries;
+}
+
+void WidgetStats::forget(const QObject* object)
+{
+    State& s = state();
+    QMutexLocker locker(&s.mutex);
+    s.index.remove(object);
+}
+
+void WidgetStats::reset()
+{
+    State& s = state();
+    QMutexLocker locker(&s.mutex);
+    s.index.clear();
+    s.entries.clear();
+    s.events.clear();
+    s.droppedEvents = 0;
+}
+
+QByteArray WidgetStats::chromeTrace()
+{
+    const qint64 pid = QCoreApplication::applicationPid();
+
+    State& s = state();
+    QMutexLocker locker(&s.mutex);
+
+    QJsonArray events;
+
+    // name the tracks first
+    for(int i=0;i<s.entries.size();i++)
+    {
+        QJsonObject args;
+        args.insert("name", s.entries[i].name);
+
+        QJsonObject event;
+        event.insert("name", QStringLiteral("thread_name"));
+        event.insert("ph", QStringLiteral("M"));
+        event.insert("pid", pid);
+        event.insert("tid", i);
+        event.insert("args", args);
+        events.append(event);
+    }
+
+    for(int i=0;i<s.events.size();i++)
+    {
+        const Event& e = s.events[i];
+
+        QJsonObject event;
+        event.insert("name", QString::fromLatin1(e.name));
+        event.insert("cat", QStringLiteral("rangesliders"));
+        event.insert("ph", QString(QLatin1Char(e.phase)));
+        event.insert("ts", e.timestamp);
+        event.insert("pid", pid);
+        event.insert("tid", e.entry);
+        if(e.phase == 'X') event.insert("dur", e.duration);
+        else event.insert("s", QStringLiteral("t")); // instant, scoped to the track
+        events.append(event);
+    }
+
+    QJsonObject trace;
+    trace.insert("traceEvents", events);
+    trace.insert("displayTimeUnit", QStringLiteral("ms"));
+    return QJsonDocument(trace).toJson(QJsonDocument::Compact);
+}
+
+bool WidgetStats::writeChromeTrace(QIODevice* device)
+{
+    const QByteArray trace = chromeTrace();
+    return device->write(trace) == trace.size();
+}
+
+bool WidgetStats::writeChromeTrace(const QString& fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    return writeChromeTrace(&file);
+}
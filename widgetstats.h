@@ -0,0 +1,126 @@
+#ifndef WIDGETSTATS_H
+#define WIDGETSTATS_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include <QLoggingCategory>
+
+#include <atomic>
+
+class QObject;
+class QIODevice;
+
+Q_DECLARE_LOGGING_CATEGORY(lcRangeSliders)
+
+// Opt-in instrumentation for the widgets in this library. When enabled, every widget counts its
+// paints (and how long they took), emitted signals, coalesced and dropped updates, animation
+// ticks and cache hits and misses. With tracing on, paints, animation frames and signals are also
+// recorded as events and can be written as a Chrome trace (chrome://tracing, ui.perfetto.dev),
+// with one track per widget.
+//
+// Disabled, every hook is a single relaxed atomic load. Event and source names aren't copied, pass
+// string literals. Timestamps are CLOCK_MONOTONIC (or whatever QElapsedTimer uses on the platform)
+// in microseconds, so the trace lines up with other traces taken on the same machine.
+//
+// Counters are keyed by object address. Call forget() when destroying a widget whose counters
+// you don't want to be inherited by the next object at that address.
+class WidgetStats
+{
+public:
+    enum Counter
+    {
+        Paints,
+        PaintMicroseconds,
+        Signals,
+        Coalesced, // updates merged into one that was pending anyway
+        Dropped, // updates that turned out to change nothing
+        AnimationTicks,
+        CacheHits,
+        CacheMisses,
+        CounterCount
+    };
+
+    struct Counters
+    {
+        Counters() { for(int i=0;i<CounterCount;i++) values[i] = 0; }
+        quint64 value(const Counter counter) const { return values[counter]; }
+
+        quint64 values[CounterCount];
+    };
+
+    struct Entry
+    {
+        QString name; // class name, plus the objectName() if there is one
+        Counters counters;
+    };
+
+    static bool isEnabled() { return sEnabled.load(std::memory_order_relaxed); }
+    static void setEnabled(const bool enabled);
+
+    // Tracing implies counting. Events beyond eventLimit() are counted in droppedEvents() only.
+    static bool isTracing() { return sTracing.load(std::memory_order_relaxed); }
+    static void setTracing(const bool tracing);
+    static int eventLimit() { return 1 << 20; }
+    static quint64 droppedEvents();
+
+    // For objects, the key is the object. Code without an object (e.g. static caches) passes a
+    // string literal as source, its address is the key.
+    static void count(const QObject* object, const Counter counter, const quint64 n = 1)
+    {
+        if(isEnabled()) record(object, nullptr, counter, n);
+    }
+    static void count(const char* source, const Counter counter, const quint64 n = 1)
+    {
+        if(isEnabled()) record(nullptr, source, counter, n);
+    }
+
+    // counts Signals, and records an instant event named after the signal when tracing
+    static void emitted(const QObject* object, const char* signal)
+    {
+        if(isEnabled()) recordSignal(object, signal);
+    }
+
+    static Counters counters(const QObject* object);
+    static QVector<Entry> entries();
+    static void forget(const QObject* object);
+    static void reset(); // clears counters and events
+
+    // {"traceEvents": [...]} as understood by chrome://tracing and Perfetto
+    static QByteArray chromeTrace();
+    static bool writeChromeTrace(QIODevice* device);
+    static bool writeChromeTrace(const QString& fileName);
+
+    // Times its own lifetime as a trace slice. A Paint scope also counts Paints and
+    // PaintMicroseconds, an Animation scope counts AnimationTicks.
+    class Scope
+    {
+    public:
+        enum Kind { Plain, Paint, Animation };
+
+        Scope(const QObject* object, const char* name, const Kind kind = Plain) :
+            mObject(object), mName(name), mKind(kind), mStart(isEnabled() ? now() : -1) { }
+        ~Scope() { if(mStart >= 0) finish(); }
+
+    private:
+        Q_DISABLE_COPY(Scope)
+        void finish();
+
+        const QObject* mObject;
+        const char* mName;
+        Kind mKind;
+        qint64 mStart; // -1 when disabled
+    };
+
+    static qint64 now(); // microseconds
+
+private:
+    static void record(const QObject* object, const char* source, const Counter counter, const quint64 n);
+    static void recordSignal(const QObject* object, const char* signal);
+
+    static std::atomic<bool> sEnabled;
+    static std::atomic<bool> sTracing;
+};
+
+#endif // WIDGETSTATS_H